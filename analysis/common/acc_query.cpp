@@ -0,0 +1,176 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+#include <set>
+#include <armadillo>
+#include "accumulator.hpp"
+#include "reweight.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Parse a job list of the form 1,3,5-8
+static bool parse_jobs(const string& list, set<int>& jobs)
+{
+    stringstream ss(list);
+    string item;
+    while(getline(ss, item, ','))
+    {
+        size_t dash = item.find('-', 1);
+        try
+        {
+            if(dash == string::npos)
+                jobs.insert(stoi(item));
+            else
+                for(int j=stoi(item.substr(0, dash)); j<=stoi(item.substr(dash+1)); ++j)
+                    jobs.insert(j);
+        }
+        catch(const exception&)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // Options can appear anywhere, the rest are positional arguments
+    set<int> jobs;
+    int first = 0;
+    int last = -1;
+    string stat = "mean";
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg.compare(0, 7, "--jobs=") == 0)
+        {
+            if(!parse_jobs(arg.substr(7), jobs))
+            {
+                cerr << "Error: option " + arg + " should be a list like --jobs=1,3,5-8" << endl;
+                return 1;
+            }
+        }
+        else if(arg.compare(0, 10, "--samples=") == 0)
+        {
+            string range = arg.substr(10);
+            size_t colon = range.find(':');
+            if(colon == string::npos)
+            {
+                cerr << "Error: option " + arg + " should be --samples=first:last" << endl;
+                return 1;
+            }
+            first = stoi(range.substr(0, colon));
+            last = stoi(range.substr(colon+1));
+        }
+        else if(arg.compare(0, 7, "--stat=") == 0)
+            stat = arg.substr(7);
+        else
+            args.push_back(arg);
+    }
+
+    // Check arguments
+    if(args.size() < 2)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) Name of the observable" << endl;
+        cerr << "Options: --jobs=1,3,5-8 to use only some jobs (default all)," << endl;
+        cerr << "         --samples=first:last to use only the blocks starting in [first, last)," << endl;
+        cerr << "         --stat=mean|sus|binder|binder_sq for the quantity to compute (default mean)" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = args[0];
+    string name = args[1];
+
+    double (*f)(const rowvec&) = 0;
+    if(stat == "sus")
+        f = rw_sus;
+    else if(stat == "binder")
+        f = rw_binder;
+    else if(stat == "binder_sq")
+        f = rw_binder_sq;
+    else if(stat != "mean")
+    {
+        cerr << "Error: unknown quantity " + stat << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN QUERY **********//
+
+    // Only the sidecar is read, never the raw data
+    AccFile acc;
+    if(!read_acc(acc_filename(path, name), acc))
+        return 1;
+
+    // Selected sums of each job, grouped by g2 in file order
+    vector<double> g2_vec;
+    vector<vector<rowvec>> sums;
+    for(const auto& ja : acc.jobs)
+    {
+        if(!jobs.empty() && !jobs.count(ja.job))
+            continue;
+
+        Moments m;
+        for(unsigned b=0; b<ja.blocks.size(); ++b)
+        {
+            int start = b*acc.block;
+            if(start >= first && (last < 0 || start < last))
+                m.merge(ja.blocks[b]);
+        }
+        if(m.n == 0)
+            continue;
+
+        if(g2_vec.empty() || g2_vec.back() != ja.g2)
+        {
+            g2_vec.push_back(ja.g2);
+            sums.push_back(vector<rowvec>());
+        }
+        sums.back().push_back(m.rw_row());
+    }
+
+    // Output mean and error, jackknife over the selected jobs
+    for(unsigned a=0; a<g2_vec.size(); ++a)
+    {
+        int n_jobs = sums[a].size();
+        double avg = 0;
+        double var = 0;
+
+        if(!f)
+        {
+            // Same estimator as the drivers: mean of the job means
+            vec samples(n_jobs);
+            for(int i=0; i<n_jobs; ++i)
+                samples(i) = rw_mean(sums[a][i]);
+            if(n_jobs > 1)
+                jackknife(samples, avg, var, my_mean);
+            else
+                avg = samples(0);
+        }
+        else
+        {
+            mat job_sums(n_jobs, RW_NCOMP);
+            for(int i=0; i<n_jobs; ++i)
+                for(int c=0; c<RW_NCOMP; ++c)
+                    job_sums(i, c) = sums[a][i](c);
+            if(n_jobs > 1)
+                jackknife_sums(job_sums, avg, var, f);
+            else
+                avg = f(sums[a][0]);
+        }
+
+        cout << g2_vec[a] << " " << avg << " " << sqrt(var) << endl;
+    }
+
+    //********* END QUERY **********//
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <armadillo>
+#include "dataset.hpp"
+#include "observables.hpp"
+#include "store.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+using namespace arma;
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 3)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) Name of the observable" << endl;
+        cerr << "3) (optional) Minimum number of blocks per job (default 8)" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = argv[1];
+    string name = argv[2];
+    int min_blocks = argc > 3 ? stoi(argv[3]) : 8;
+
+    const Observable* obs = find_observable(name);
+    if(!obs)
+    {
+        cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+        for(const auto& o : observables())
+            cerr << o.name << endl;
+        return 1;
+    }
+
+    if(min_blocks < 2)
+    {
+        cerr << "Error: need at least two blocks per job." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN ANALYSIS **********//
+
+
+    // Open output file
+    string out_filename = path + "/observables/" + name + "_blocking.txt";
+    ofstream out_obs;
+    out_obs.open(out_filename);
+
+    if(!out_obs)
+    {
+        cerr << "Error: file " + out_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    int n_jobs = ds.job_vec.size();
+
+    // Cycle on g2 values
+    for(const auto& g2 : ds.g2_vec)
+    {
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        // Only the block sums are read, never the samples
+        vector<BlockPyramid> pyr(n_jobs);
+        vector<char> ok(n_jobs, 1);
+        parallel_for(0, n_jobs, [&](int i, int)
+        {
+            ok[i] = read_pyramid(ds, g2, ds.job_vec[i], *obs, pyr[i]);
+        });
+
+        int depth = 64;
+        for(int i=0; i<n_jobs; ++i)
+        {
+            if(!ok[i])
+            {
+                cerr << "Error: no up to date stored values of job " << ds.job_vec[i] << " at g2 " << g2 << ", run multi_obs first." << endl;
+                return 1;
+            }
+            depth = std::min(depth, pyr[i].depth());
+        }
+
+        // Squared error of the mean of the job means for blocks of 2^k samples,
+        // as long as every job has enough blocks
+        vector<double> err2;
+        for(int k=0; k<=depth; ++k)
+        {
+            double temp = 0;
+            bool enough = true;
+            for(int i=0; i<n_jobs && enough; ++i)
+            {
+                if(k == 0)
+                {
+                    // Single samples are blocks too, and the variance needs two
+                    double n = pyr[i].size();
+                    enough = n >= min_blocks;
+                    if(enough)
+                    {
+                        double avg = pyr[i].sum()/n;
+                        temp += (pyr[i].sum_sq()/n - avg*avg)/(n-1);
+                    }
+                    continue;
+                }
+
+                vec means = pyr[i].block_means(k);
+                enough = (int)means.n_elem >= min_blocks;
+                if(enough)
+                    temp += var(means)/means.n_elem;
+            }
+            if(!enough)
+                break;
+            err2.push_back(temp/(n_jobs*n_jobs));
+        }
+
+        if(err2.empty())
+        {
+            clog << "Warning: fewer than " << min_blocks << " samples in some job at g2 " << g2 << ", no error estimate." << endl;
+            continue;
+        }
+
+        // Columns are g2, block size, error, integrated autocorrelation time
+        for(unsigned k=0; k<err2.size(); ++k)
+            out_obs << g2 << " " << (1 << k) << " " << sqrt(err2[k]) << " " << 0.5*err2[k]/err2[0] << endl;
+    }
+
+    out_obs.close();
+
+    //********* END ANALYSIS **********//
+
+    return 0;
+}
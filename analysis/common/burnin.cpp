@@ -0,0 +1,161 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <armadillo>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "observables.hpp"
+#include "parallel.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 2)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) (optional) Names of the observables to monitor (default S)" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = argv[1];
+    vector<const Observable*> obs_vec;
+    for(int i=2; i<argc; ++i)
+    {
+        const Observable* obs = find_observable(argv[i]);
+        if(!obs)
+        {
+            cerr << "Error: observable " + string(argv[i]) + " is not registered." << endl;
+            return 1;
+        }
+        obs_vec.push_back(obs);
+    }
+    if(obs_vec.empty())
+        obs_vec.push_back(find_observable("S"));
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    // Detection always runs on the full chains, not decimated
+    ds.burnin.clear();
+    ds.dec = Decimation();
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN DETECTION **********//
+
+    int n_jobs = ds.job_vec.size();
+    int n_obs = obs_vec.size();
+
+    // Only the parts of the samples the observables need are decoded
+    Projection proj = projection(ds, obs_vec);
+
+    // Burn-in cuts, one row per g2
+    Mat<int> cuts(ds.g2_vec.size(), n_jobs);
+
+    for(unsigned a=0; a<ds.g2_vec.size(); ++a)
+    {
+        double g2 = ds.g2_vec[a];
+
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        vector<char> ok(n_jobs, 1);
+        vec z_max(n_jobs, fill::zeros);
+        parallel_for(0, n_jobs, [&](int i, int)
+        {
+            SampleReader reader(ds, g2, ds.job_vec[i], proj);
+            if(!reader.is_open())
+            {
+                ok[i] = 0;
+                return;
+            }
+
+            // Series of every monitored observable
+            vector<vec> series(n_obs, vec(reader.size()));
+            Sample smp(ds);
+            for(int j=0; j<reader.size(); ++j)
+            {
+                if(!reader.read(smp))
+                {
+                    ok[i] = 0;
+                    return;
+                }
+                for(int k=0; k<n_obs; ++k)
+                    series[k](j) = obs_vec[k]->f(smp, g2);
+            }
+
+            // The cut of the job is the most conservative one
+            int cut = 0;
+            for(int k=0; k<n_obs; ++k)
+                cut = std::max(cut, mser_cut(series[k]));
+            cuts(a, i) = cut;
+
+            // Check that what is left looks stationary
+            for(int k=0; k<n_obs; ++k)
+            {
+                int n = series[k].n_elem;
+                if(n - cut < 20)
+                    continue;
+                double z = geweke_z(series[k].subvec(cut, n-1));
+                z_max(i) = std::max(z_max(i), std::abs(z));
+            }
+        });
+
+        for(int i=0; i<n_jobs; ++i)
+        {
+            if(!ok[i])
+            {
+                cerr << "Error: couldn't read job " << ds.job_vec[i] << " at g2 " << g2 << endl;
+                return 1;
+            }
+            if(z_max(i) > 2)
+                clog << "Warning: job " << ds.job_vec[i] << " at g2 " << g2 << " fails the Geweke test after the cut (|z| = " << z_max(i) << ")" << endl;
+            if(2*cuts(a, i) >= ds.sm.samples)
+                clog << "Warning: job " << ds.job_vec[i] << " at g2 " << g2 << " has a burn-in of half the chain or more" << endl;
+        }
+    }
+
+    //********* END DETECTION **********//
+
+
+
+    //********* BEGIN OUTPUT **********//
+
+    // Index file read by every reader of the dataset
+    string out_filename = path + "/burnin.txt";
+    ofstream out_burnin;
+    out_burnin.open(out_filename);
+
+    if(!out_burnin)
+    {
+        cerr << "Error: file " + out_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    out_burnin << setprecision(12);
+    for(unsigned a=0; a<ds.g2_vec.size(); ++a)
+        for(int i=0; i<n_jobs; ++i)
+            out_burnin << ds.g2_vec[a] << " " << ds.job_vec[i] << " " << cuts(a, i) << endl;
+
+    out_burnin.close();
+
+    //********* END OUTPUT **********//
+
+    return 0;
+}
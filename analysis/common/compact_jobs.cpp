@@ -0,0 +1,122 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "cache.hpp"
+#include "compact.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+// Whether every job of a coupling is compacted and unchanged since
+static bool up_to_date(const Dataset& ds, double g2)
+{
+    for(const auto& job : ds.job_vec)
+    {
+        FileStamp hl;
+        bool has_hl = file_stamp(data_path(ds, g2, job) + "_HL.txt", hl);
+
+        SampleIndex idx;
+        if(!compacted_index(ds, g2, job, has_hl, idx))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 2)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "Options: --shard=MB size of a shard (default 4096), --force to compact couplings that are up to date" << endl;
+        cerr << "The original files are kept: F, F_new, S, S_new, dofs, base_analysis and the p2q0 drivers" << endl;
+        cerr << "read them with ifstream and can't find them in the shards" << endl;
+        return 1;
+    }
+
+    // Options can appear anywhere, the rest are positional arguments
+    long long shard_mb = 4096;
+    bool force = false;
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg.compare(0, 8, "--shard=") == 0)
+            shard_mb = stoll(arg.substr(8));
+        else if(arg == "--force")
+            force = true;
+        else if(arg == "--remove")
+        {
+            cerr << "Error: --remove is not supported, the drivers that read the job files with ifstream can't read the shards." << endl;
+            return 1;
+        }
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Error: unknown option " + arg << endl;
+            return 1;
+        }
+        else
+            args.push_back(arg);
+    }
+    string path = args.size() ? args[0] : "";
+
+    if(shard_mb < 1)
+    {
+        cerr << "Error: shards must be at least 1 MB." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN COMPACTION **********//
+
+    // Couplings are independent, each one is packed by a thread
+    int n_g2 = ds.g2_vec.size();
+    vector<char> ok(n_g2, 1);
+    vector<char> fresh(n_g2, 0);
+    vector<long long> n_bad(n_g2, 0);
+    parallel_for(0, n_g2, [&](int i, int)
+    {
+        double g2 = ds.g2_vec[i];
+        if(!force && up_to_date(ds, g2))
+            fresh[i] = 1;
+        else if(!compact_coupling(ds, g2, shard_mb << 20) || !verify_compacted(ds, g2, n_bad[i]))
+            ok[i] = 0;
+    });
+
+    for(int i=0; i<n_g2; ++i)
+    {
+        // Print value of g2 processed
+        clog << "g2: " << ds.g2_vec[i] << endl;
+
+        if(!ok[i])
+        {
+            cerr << "Error: couldn't compact the jobs at g2 " << ds.g2_vec[i] << endl;
+            return 1;
+        }
+        if(n_bad[i])
+        {
+            cerr << "Error: " << n_bad[i] << " files don't match their shards at g2 " << ds.g2_vec[i] << endl;
+            return 1;
+        }
+        clog << (fresh[i] ? "already compacted" : "compacted") << endl;
+    }
+
+    //********* END COMPACTION **********//
+
+    return 0;
+}
@@ -0,0 +1,335 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <armadillo>
+#include "dataset.hpp"
+#include "observables.hpp"
+#include "reweight.hpp"
+#include "scaling.hpp"
+#include "parallel.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Peak of the susceptibility of one curve, from the reweighted grid (rw)
+// and from a local quadratic fit to the simulated points only (fit)
+struct Peak
+{
+    double g2_rw, g2_rw_err, sus_rw, sus_rw_err;
+    double g2_fit, g2_fit_err, sus_fit, sus_fit_err;
+};
+
+// Jackknife over the delete-1 estimates that were found only. Filling in
+// the failures with the full estimate would shrink the error, so they are
+// left out instead. False if fewer than two are left
+static bool jackknife_found(const vec& del1, const vector<char>& found, double& avg, double& var)
+{
+    vec kept(count(found.begin(), found.end(), 1));
+    for(unsigned i=0, k=0; i<found.size(); ++i)
+        if(found[i])
+            kept(k++) = del1(i);
+
+    if(kept.n_elem < 2)
+        return false;
+    jackknife_del1(kept, avg, var);
+    return true;
+}
+
+static void curve_peak(const RwCurve& curve, Peak& pk)
+{
+    vec x, y;
+    curve_values(curve, rw_sus, x, y);
+    if(!find_peak(x, y, pk.g2_rw, pk.sus_rw))
+        clog << "Warning: reweighted susceptibility peak of dim " << curve.dim << " is at the boundary" << endl;
+    curve_values(curve, rw_sus, x, y, -1, true);
+    bool fitted = fit_peak(x, y, 2, pk.g2_fit, pk.sus_fit);
+    if(!fitted)
+        clog << "Warning: quadratic fit of the susceptibility of dim " << curve.dim << " has no maximum, the largest point is given without error" << endl;
+    pk.g2_rw_err = pk.sus_rw_err = pk.g2_fit_err = pk.sus_fit_err = 0;
+
+    if(curve.n_jobs < 2)
+        return;
+
+    // Delete-1 peaks, computed in parallel
+    vec g2_rw(curve.n_jobs), sus_rw(curve.n_jobs), g2_fit(curve.n_jobs), sus_fit(curve.n_jobs);
+    vector<char> rw_ok(curve.n_jobs, 0), fit_ok(curve.n_jobs, 0);
+    parallel_for(0, curve.n_jobs, [&](int i, int)
+    {
+        vec xi, yi;
+        curve_values(curve, rw_sus, xi, yi, i);
+        rw_ok[i] = find_peak(xi, yi, g2_rw(i), sus_rw(i));
+        curve_values(curve, rw_sus, xi, yi, i, true);
+        fit_ok[i] = fit_peak(xi, yi, 2, g2_fit(i), sus_fit(i));
+    });
+
+    // Only maxima inside the range enter the jackknife, never boundary points
+    double var;
+    int n_rw = count(rw_ok.begin(), rw_ok.end(), 1);
+    if(!jackknife_found(g2_rw, rw_ok, pk.g2_rw, var))
+    {
+        clog << "Warning: reweighted susceptibility peak of dim " << curve.dim << " is at the boundary without most jobs, no error" << endl;
+        pk.g2_rw_err = pk.sus_rw_err = NAN;
+    }
+    else
+    {
+        if(n_rw < curve.n_jobs)
+            clog << "Warning: reweighted susceptibility peak of dim " << curve.dim << " is at the boundary without " << curve.n_jobs-n_rw << " of the jobs, they are left out of the error" << endl;
+        pk.g2_rw_err = sqrt(var);
+        jackknife_found(sus_rw, rw_ok, pk.sus_rw, var);
+        pk.sus_rw_err = sqrt(var);
+    }
+
+    // Only fitted maxima enter the jackknife, never the largest point
+    int n_fit = count(fit_ok.begin(), fit_ok.end(), 1);
+    if(!fitted)
+        pk.g2_fit_err = pk.sus_fit_err = NAN;
+    else if(!jackknife_found(g2_fit, fit_ok, pk.g2_fit, var))
+    {
+        clog << "Warning: quadratic fit of the susceptibility of dim " << curve.dim << " fails without most jobs, no error" << endl;
+        pk.g2_fit_err = pk.sus_fit_err = NAN;
+    }
+    else
+    {
+        if(n_fit < curve.n_jobs)
+            clog << "Warning: quadratic fit of the susceptibility of dim " << curve.dim << " fails without " << curve.n_jobs-n_fit << " of the jobs, they are left out of the error" << endl;
+        pk.g2_fit_err = sqrt(var);
+        jackknife_found(sus_fit, fit_ok, pk.sus_fit, var);
+        pk.sus_fit_err = sqrt(var);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 6)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Name of the observable" << endl;
+        cerr << "2) Number of reweighted points between neighbouring g2 values" << endl;
+        cerr << "3) Power of the order parameter the observable is equal to (1 or 2)" << endl;
+        cerr << "4) Path to output folder" << endl;
+        cerr << "5) A bunch of paths to datasets" << endl;
+        cerr << "Options: --ess=x minimum effective sample size of a reweighted point, as a fraction of the samples (default 0.1)" << endl;
+        return 1;
+    }
+
+    // Options can appear anywhere, the rest are positional arguments
+    double ess_min = 0.1;
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg.compare(0, 6, "--ess=") == 0)
+            ess_min = stod(arg.substr(6));
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Error: unknown option " + arg << endl;
+            return 1;
+        }
+        else
+            args.push_back(arg);
+    }
+
+    if(args.size() < 5)
+    {
+        cerr << "Error: need an observable, the points, the power, an output folder and at least one dataset." << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string name = args[0];
+    int n_pts = stoi(args[1]);
+    int power = stoi(args[2]);
+    string out_path = args[3];
+    vector<string> datasets(args.begin()+4, args.end());
+
+    const Observable* obs = find_observable(name);
+    if(!obs)
+    {
+        cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+        for(const auto& o : observables())
+            cerr << o.name << endl;
+        return 1;
+    }
+
+    if(power != 1 && power != 2)
+    {
+        cerr << "Error: the observable must be the order parameter or its square." << endl;
+        return 1;
+    }
+    double (*binder)(const rowvec&) = (power == 1) ? rw_binder : rw_binder_sq;
+
+
+
+    //********* BEGIN CURVES **********//
+
+    vector<RwCurve> curves(datasets.size());
+    for(unsigned d=0; d<datasets.size(); ++d)
+    {
+        Dataset ds;
+        if(!read_dataset(datasets[d], ds))
+            return 1;
+
+        if(!build_rw_curve(ds, *obs, n_pts, ess_min, curves[d]))
+            return 1;
+    }
+
+    // Sort curves by dimension
+    vector<int> order(curves.size());
+    for(unsigned d=0; d<order.size(); ++d)
+        order[d] = d;
+    sort(order.begin(), order.end(), [&](int a, int b) { return curves[a].dim < curves[b].dim; });
+
+    //********* END CURVES **********//
+
+
+
+    //********* BEGIN SUSCEPTIBILITY PEAKS **********//
+
+    string peak_filename = out_path + "/" + name + "_peak.txt";
+    ofstream out_peak;
+    out_peak.open(peak_filename);
+
+    if(!out_peak)
+    {
+        cerr << "Error: file " + peak_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    // Columns are dim, then position, error, height, error of the
+    // reweighted peak and the same for the quadratic fit
+    vector<Peak> peaks(curves.size());
+    for(int d : order)
+    {
+        clog << "dim: " << curves[d].dim << endl;
+        curve_peak(curves[d], peaks[d]);
+        const Peak& pk = peaks[d];
+        out_peak << curves[d].dim << " " << pk.g2_rw << " " << pk.g2_rw_err << " " << pk.sus_rw << " " << pk.sus_rw_err;
+        out_peak << " " << pk.g2_fit << " " << pk.g2_fit_err << " " << pk.sus_fit << " " << pk.sus_fit_err << endl;
+    }
+
+    out_peak.close();
+
+    //********* END SUSCEPTIBILITY PEAKS **********//
+
+
+
+    //********* BEGIN BINDER CUMULANTS **********//
+
+    // Full and delete-1 Binder curves of each dataset
+    vector<vec> bx(curves.size()), by(curves.size());
+    vector<vector<vec>> by_del1(curves.size());
+    for(unsigned d=0; d<curves.size(); ++d)
+    {
+        const RwCurve& curve = curves[d];
+        curve_values(curve, binder, bx[d], by[d]);
+
+        by_del1[d].assign(curve.n_jobs, vec());
+        parallel_for(0, curve.n_jobs, [&](int i, int)
+        {
+            vec xi;
+            curve_values(curve, binder, xi, by_del1[d][i], i);
+        });
+
+        // Output Binder cumulant along the curve
+        string out_filename = datasets[d] + "/observables/" + name + "_binder.txt";
+        ofstream out_obs;
+        out_obs.open(out_filename);
+
+        if(!out_obs)
+        {
+            cerr << "Error: file " + out_filename + " could not be opened." << endl;
+            return 1;
+        }
+
+        for(unsigned n=0; n<bx[d].n_elem; ++n)
+        {
+            double avg = by[d](n), var = 0;
+            if(curve.n_jobs > 1)
+            {
+                vec del1(curve.n_jobs);
+                for(int i=0; i<curve.n_jobs; ++i)
+                    del1(i) = by_del1[d][i](n);
+                jackknife_del1(del1, avg, var);
+            }
+            out_obs << bx[d](n) << " " << avg << " " << sqrt(var) << endl;
+        }
+
+        out_obs.close();
+    }
+
+    // Pairwise crossings; the datasets are independent, so the
+    // jackknife variances from leaving out jobs of either one add up
+    string cross_filename = out_path + "/" + name + "_binder_cross.txt";
+    ofstream out_cross;
+    out_cross.open(cross_filename);
+
+    if(!out_cross)
+    {
+        cerr << "Error: file " + cross_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    for(unsigned a=0; a<order.size(); ++a)
+    {
+        for(unsigned b=a+1; b<order.size(); ++b)
+        {
+            int d1 = order[a];
+            int d2 = order[b];
+            double hint = 0.5*(peaks[d1].g2_rw + peaks[d2].g2_rw);
+
+            double g2_c, U_c;
+            if(!find_crossing(bx[d1], by[d1], bx[d2], by[d2], hint, g2_c, U_c))
+            {
+                clog << "Warning: Binder cumulants of dims " << curves[d1].dim << " and " << curves[d2].dim << " do not cross" << endl;
+                continue;
+            }
+
+            // Crossings missing without a job are left out of the error
+            double var_g2 = 0, var_U = 0;
+            for(int d : {d1, d2})
+            {
+                int n_jobs = curves[d].n_jobs;
+                if(n_jobs < 2)
+                    continue;
+
+                vec g2_del1(n_jobs), U_del1(n_jobs);
+                vector<char> found(n_jobs, 0);
+                for(int i=0; i<n_jobs; ++i)
+                {
+                    const vec& y1 = (d == d1) ? by_del1[d1][i] : by[d1];
+                    const vec& y2 = (d == d2) ? by_del1[d2][i] : by[d2];
+                    found[i] = find_crossing(bx[d1], y1, bx[d2], y2, hint, g2_del1(i), U_del1(i));
+                }
+
+                int n_found = count(found.begin(), found.end(), 1);
+                double avg, var;
+                if(!jackknife_found(g2_del1, found, avg, var))
+                {
+                    clog << "Warning: Binder cumulants of dims " << curves[d1].dim << " and " << curves[d2].dim << " do not cross without most jobs of dim " << curves[d].dim << ", no error" << endl;
+                    var_g2 = var_U = NAN;
+                    break;
+                }
+                if(n_found < n_jobs)
+                    clog << "Warning: Binder cumulants of dims " << curves[d1].dim << " and " << curves[d2].dim << " do not cross without " << n_jobs-n_found << " of the jobs of dim " << curves[d].dim << ", they are left out of the error" << endl;
+                var_g2 += var;
+                jackknife_found(U_del1, found, avg, var);
+                var_U += var;
+            }
+
+            out_cross << curves[d1].dim << " " << curves[d2].dim << " " << g2_c << " " << sqrt(var_g2) << " " << U_c << " " << sqrt(var_U) << endl;
+        }
+    }
+
+    out_cross.close();
+
+    //********* END BINDER CUMULANTS **********//
+
+    return 0;
+}
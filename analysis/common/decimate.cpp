@@ -1,166 +1,104 @@
 #include <iostream>
 #include <string>
-#include <fstream>
-#include <iomanip>
 #include <cstdlib>
-#include <armadillo>
-#include "geometry.hpp"
-#include "utils.hpp"
-#include "params.hpp"
-#include "statistics.hpp"
+#include <vector>
+#include <algorithm>
+#include "dataset.hpp"
 
 using namespace std;
-using namespace arma;
 
 int main(int argc, char** argv)
 {
     // Check arguments
-    if(argc < 5)
+    if(argc < 2)
     {
         cerr << "Need to pass:" << endl;
-        cerr << "1) Name of the folder containing the data" << endl;
-        cerr << "2) First index of the jobs array" << endl;
-        cerr << "3) Number of jobs in the array" << endl;
-        cerr << "4) Decimation factor" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "Options: --stride=n to keep one sample every n, --offset=n to skip n more samples after the cut," << endl;
+        cerr << "         --cut=n to skip at least n samples of every job, --max=n to keep at most n samples (0 for all)," << endl;
+        cerr << "         --clear to go back to every sample first. Options left out keep their current value" << endl;
+        cerr << "The old layout (path/<job>/ with g2 from init.txt) is decimated in place by decimate_legacy" << endl;
         return 1;
     }
 
-    // Some declarations for later
-    string prefix = "GEOM";
-    string path = argv[1];
-    int fst_jarr = stoi(argv[2]);
-    int num_jarr = stoi(argv[3]);
-    int dec = stoi(argv[4]); 
-
-
-
-    //********* BEGIN PARAMETER INITIALIZATION **********//
-    
-    // Read simulation parameters from file path/init.txt
-    string init_filename = path + "/init.txt";
-
-    struct Simul_params sm;
-    ifstream in_init;
-    in_init.open(init_filename);
-
-    if(!read_init_stream(in_init, sm))
+    // Options can appear anywhere, the rest are positional arguments
+    bool clear = false;
+    vector<pair<string, int>> set;
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
     {
-        cerr << "Error: couldn't read file " + init_filename << endl;
-        return 1;
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string key = arg.substr(0, eq);
+        if(arg == "--clear")
+            clear = true;
+        else if(eq != string::npos && (key == "--stride" || key == "--offset" || key == "--cut" || key == "--max"))
+            set.push_back(make_pair(key.substr(2), stoi(arg.substr(eq+1))));
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Error: unknown option " + arg << endl;
+            return 1;
+        }
+        else
+            args.push_back(arg);
     }
+    string path = args.size() ? args[0] : "";
 
-    cout << "File " + init_filename + " contains the following parameters:" << endl;
-    cout << sm.control << endl;
 
-    if(!params_validity(sm))
-    {
-        cerr << "Error: file " + init_filename + " does not contain the necessary parameters." << endl;
-        return 1;
-    }
 
-    in_init.close();
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
 
-    //********* END PARAMETER INITIALIZATION **********//
+    //********* END DATASET INITIALIZATION **********//
 
 
 
     //********* BEGIN DECIMATION **********//
-    
 
-    // Cycle on g2 values
-    double g2 = sm.g2_i;
-    while(g2 < sm.g2_f)
+    // The data files stay as they are, readers apply the view recorded in
+    // path/decimation.txt
+    Decimation dec = clear ? Decimation() : ds.dec;
+    for(const auto& s : set)
     {
-        // Print value of g2 being precessed
-        clog << "g2: " << g2 << endl;
-
-        // Cycle on jobs in the array
-        for(int i=0; i<num_jarr; ++i)
-        {
-            // Open input files
-            string array_path = path + "/" + to_string(i+fst_jarr);
-            string filename = filename_from_data(sm.p, sm.q, sm.dim, g2, prefix);
-            ifstream in_s, in_hl;
-            string full_name_s = array_path + "/" + filename + "_S.txt";
-            string full_name_hl = array_path + "/" + filename + "_HL.txt";
-            in_s.open(full_name_s);
-            in_hl.open(full_name_hl);
-    
-            // Open output file 
-            ofstream out_s, out_hl;
-            out_s.open(full_name_s + ".tmp");
-            out_hl.open(full_name_hl + ".tmp");
-
-            if(!(out_s && out_hl))
-            {
-                cerr << "Error: decimated file could not be opened." << endl;
-                return 1;
-            }
-            
-            // Create vector of correlated samples
-            int length = n_meas(sm.iter_simul, sm.gap);
-
-            // Cycle on samples
-            for(int j=0; j<length; ++j) 
-            {
-                Geom24 G(sm.p, sm.q, sm.dim, g2);
-                double S2, S4;
-                in_s >> S2 >> S4;
-                G.read_mat(in_hl);
-
-                // ***** COPY DATA HERE *****
-                if( !(j%dec) )
-                {
-                    // print S2 and S4
-                    out_s << S2 << " " << S4 << endl;
-                    
-                    // print mat
-                    for(int j=0; j<G.get_nHL(); ++j)
-                    {
-                        for(int k=0; k<sm.dim; ++k)
-                        {
-                            for(int l=0; l<sm.dim; ++l)
-                                out_hl << G.get_mat(j)(k,l).real() << " " << G.get_mat(j)(k,l).imag() << " ";
-                        }
-                        out_hl << endl;
-                    }
-                }
-
-                // ***** THAT'S IT, YOU'RE DONE *****
-
-            }
-            in_s.close();
-            in_hl.close();
-            out_s.close();
-            out_hl.close();
-
-            remove(full_name_s.c_str());
-            rename((full_name_s+".tmp").c_str(), full_name_s.c_str());
-            remove(full_name_hl.c_str());
-            rename((full_name_hl+".tmp").c_str(), full_name_hl.c_str());
-        }
-
-        g2 += sm.g2_step;
+        if(s.first == "stride")
+            dec.stride = s.second;
+        else if(s.first == "offset")
+            dec.offset = s.second;
+        else if(s.first == "cut")
+            dec.cut = s.second;
+        else
+            dec.max = s.second;
     }
 
+    if(dec.stride < 1 || dec.offset < 0 || dec.cut < 0 || dec.max < 0)
+    {
+        cerr << "Error: stride must be at least 1, the rest can't be negative." << endl;
+        return 1;
+    }
 
-    
-    // Log the decimation on file
-    string log_filename = path + "/decimation.log";
-    ofstream out_log;
-    out_log.open(log_filename);
+    if((clear || set.size()) && !write_decimation(path, dec))
+        return 1;
+    ds.dec = dec;
 
-    if(!out_log)
+    // Samples left in the jobs, with a warning for those the view empties
+    int n_min = ds.sm.samples;
+    int n_max = 0;
+    for(const auto& g2 : ds.g2_vec)
     {
-        cerr << "Error: couldn't open file " + log_filename << endl;
-        return 1;
+        for(const auto& job : ds.job_vec)
+        {
+            int n = job_view(ds.burnin, dec, g2, job, ds.sm.samples).size;
+            n_min = min(n_min, n);
+            n_max = max(n_max, n);
+        }
     }
 
-    out_log << "Decimated data." << endl;
-    out_log << "Decimation factor: " << dec;
+    clog << "cut " << dec.cut << ", offset " << dec.offset << ", stride " << dec.stride << ", max " << dec.max << endl;
+    clog << "samples per job: " << n_min << " to " << n_max << " of " << ds.sm.samples << endl;
 
-    out_log.close();
-    
     //********* END DECIMATION **********//
 
     return 0;
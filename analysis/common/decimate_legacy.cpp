@@ -0,0 +1,171 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include "geometry.hpp"
+#include "utils.hpp"
+#include "params.hpp"
+
+using namespace std;
+
+// Decimation of the old layout (path/<job>/, g2 from init.txt), which has
+// no g2_val.txt and job_idx.txt and so no view: the files are rewritten.
+// The new layout is decimated by decimate, which only records a view
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 5)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Name of the folder containing the data" << endl;
+        cerr << "2) First index of the jobs array" << endl;
+        cerr << "3) Number of jobs in the array" << endl;
+        cerr << "4) Decimation factor" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string prefix = "GEOM";
+    string path = argv[1];
+    int fst_jarr = stoi(argv[2]);
+    int num_jarr = stoi(argv[3]);
+    int dec = stoi(argv[4]);
+
+    if(dec < 1)
+    {
+        cerr << "Error: decimation factor must be at least 1." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN PARAMETER INITIALIZATION **********//
+
+    // Read simulation parameters from file path/init.txt
+    string init_filename = path + "/init.txt";
+
+    struct Simul_params sm;
+    ifstream in_init;
+    in_init.open(init_filename);
+
+    if(!read_init_stream(in_init, sm))
+    {
+        cerr << "Error: couldn't read file " + init_filename << endl;
+        return 1;
+    }
+
+    cout << "File " + init_filename + " contains the following parameters:" << endl;
+    cout << sm.control << endl;
+
+    if(!params_validity(sm))
+    {
+        cerr << "Error: file " + init_filename + " does not contain the necessary parameters." << endl;
+        return 1;
+    }
+
+    in_init.close();
+
+    //********* END PARAMETER INITIALIZATION **********//
+
+
+
+    //********* BEGIN DECIMATION **********//
+
+
+    // Cycle on g2 values
+    double g2 = sm.g2_i;
+    while(g2 < sm.g2_f)
+    {
+        // Print value of g2 being precessed
+        clog << "g2: " << g2 << endl;
+
+        // Each matrix is written on its own line
+        Geom24 G(sm.p, sm.q, sm.dim, g2);
+        int nHL = G.get_nHL();
+
+        // Cycle on jobs in the array
+        for(int i=0; i<num_jarr; ++i)
+        {
+            // Open input files
+            string array_path = path + "/" + to_string(i+fst_jarr);
+            string filename = filename_from_data(sm.p, sm.q, sm.dim, g2, prefix);
+            ifstream in_s, in_hl;
+            string full_name_s = array_path + "/" + filename + "_S.txt";
+            string full_name_hl = array_path + "/" + filename + "_HL.txt";
+            in_s.open(full_name_s);
+            in_hl.open(full_name_hl);
+
+            if(!(in_s && in_hl))
+            {
+                cerr << "Error: files " + array_path + "/" + filename + "_S.txt and _HL.txt could not be opened." << endl;
+                return 1;
+            }
+
+            // Open output file
+            ofstream out_s, out_hl;
+            out_s.open(full_name_s + ".tmp");
+            out_hl.open(full_name_hl + ".tmp");
+
+            if(!(out_s && out_hl))
+            {
+                cerr << "Error: decimated file could not be opened." << endl;
+                return 1;
+            }
+
+            // Cycle on samples, lines are copied as they are so that
+            // the kept samples don't change
+            string line;
+            for(int j=0; getline(in_s, line); ++j)
+            {
+                if( !(j%dec) )
+                    out_s << line << endl;
+
+                for(int k=0; k<nHL && getline(in_hl, line); ++k)
+                {
+                    if( !(j%dec) )
+                        out_hl << line << endl;
+                }
+            }
+            in_s.close();
+            in_hl.close();
+            out_s.close();
+            out_hl.close();
+
+            if(!(out_s && out_hl))
+            {
+                cerr << "Error: decimated files of " + array_path + " could not be written." << endl;
+                return 1;
+            }
+
+            remove(full_name_s.c_str());
+            rename((full_name_s+".tmp").c_str(), full_name_s.c_str());
+            remove(full_name_hl.c_str());
+            rename((full_name_hl+".tmp").c_str(), full_name_hl.c_str());
+        }
+
+        g2 += sm.g2_step;
+    }
+
+
+
+    // Log the decimation on file
+    string log_filename = path + "/decimation.log";
+    ofstream out_log;
+    out_log.open(log_filename);
+
+    if(!out_log)
+    {
+        cerr << "Error: couldn't open file " + log_filename << endl;
+        return 1;
+    }
+
+    out_log << "Decimated data." << endl;
+    out_log << "Decimation factor: " << dec;
+
+    out_log.close();
+
+    //********* END DECIMATION **********//
+
+    return 0;
+}
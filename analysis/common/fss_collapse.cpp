@@ -0,0 +1,241 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <armadillo>
+#include "utils.hpp"
+#include "dataset.hpp"
+#include "observables.hpp"
+#include "scaling.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Parse an option of the form --key=lo:hi
+static bool parse_range(const string& arg, const string& key, double& lo, double& hi)
+{
+    string head = "--" + key + "=";
+    if(arg.compare(0, head.size(), head) != 0)
+        return false;
+
+    string range = arg.substr(head.size());
+    size_t colon = range.find(':');
+    if(colon == string::npos)
+    {
+        lo = hi = stod(range);
+        return true;
+    }
+    lo = stod(range.substr(0, colon));
+    hi = stod(range.substr(colon+1));
+    return true;
+}
+
+// Mean and jackknife error over the jobs of each g2, leaving out job skip if >= 0
+static void job_average(const mat& means, vec& y, vec& err, int skip=-1)
+{
+    int n_g2 = means.n_rows;
+    int n_jobs = means.n_cols;
+    y.set_size(n_g2);
+    err.set_size(n_g2);
+
+    for(int a=0; a<n_g2; ++a)
+    {
+        vec samples(skip >= 0 ? n_jobs-1 : n_jobs);
+        int m = 0;
+        for(int i=0; i<n_jobs; ++i)
+            if(i != skip)
+                samples(m++) = means(a, i);
+
+        double avg = mean(samples);
+        double var = 0;
+        if(samples.n_elem > 1)
+            jackknife(samples, avg, var, my_mean);
+        y(a) = avg;
+        err(a) = sqrt(var);
+    }
+}
+
+// Whether some searched parameter sits on the edge of the box [lo, hi]
+static bool on_edge(const CollapseParams& par, const CollapseParams& lo, const CollapseParams& hi)
+{
+    const double v[3] = {par.a, par.b, par.g2c};
+    const double l[3] = {lo.a, lo.b, lo.g2c};
+    const double h[3] = {hi.a, hi.b, hi.g2c};
+    for(int p=0; p<3; ++p)
+    {
+        double tol = 1e-9*(h[p]-l[p]);
+        if(h[p] > l[p] && (v[p] <= l[p]+tol || v[p] >= h[p]-tol))
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    // Options can appear anywhere, the rest are positional arguments
+    CollapseParams lo = {0, 0, 0};
+    CollapseParams hi = {0, 0, 0};
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(parse_range(arg, "xexp", lo.b, hi.b) || parse_range(arg, "shift", lo.g2c, hi.g2c))
+            continue;
+        args.push_back(arg);
+    }
+
+    // Check arguments
+    if(args.size() < 5)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Name of the observable" << endl;
+        cerr << "2) Minimum power of dim to divide by" << endl;
+        cerr << "3) Maximum power of dim to divide by" << endl;
+        cerr << "4) Path to output folder" << endl;
+        cerr << "5) A bunch of paths to datasets" << endl;
+        cerr << "Options: --xexp=lo:hi to also scale g2 by a power of dim," << endl;
+        cerr << "         --shift=lo:hi to also search the critical g2" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string name = args[0];
+    lo.a = stod(args[1]);
+    hi.a = stod(args[2]);
+    string out_path = args[3];
+    vector<string> datasets(args.begin()+4, args.end());
+
+    const Observable* obs = find_observable(name);
+    if(!obs)
+    {
+        cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+        for(const auto& o : observables())
+            cerr << o.name << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN READ DATA **********//
+
+    // Job means are read once per dataset, every trial exponent reuses them
+    int n_sets = datasets.size();
+    vector<mat> means(n_sets);
+    vector<CollapseSet> sets(n_sets);
+    for(int d=0; d<n_sets; ++d)
+    {
+        Dataset ds;
+        if(!read_dataset(datasets[d], ds))
+            return 1;
+
+        if(!load_job_means(ds, *obs, means[d]))
+            return 1;
+
+        sets[d].dim = ds.sm.dim;
+        sets[d].g2.set_size(ds.g2_vec.size());
+        for(unsigned a=0; a<ds.g2_vec.size(); ++a)
+            sets[d].g2(a) = ds.g2_vec[a];
+        job_average(means[d], sets[d].y, sets[d].err);
+    }
+
+    //********* END READ DATA **********//
+
+
+
+    //********* BEGIN COLLAPSE **********//
+
+    CollapseParams best;
+    double quality = collapse_search(sets, lo, hi, best);
+    cout << "Best collapse: a = " << best.a << ", b = " << best.b << ", g2c = " << best.g2c << ", quality = " << quality << endl;
+
+    if(on_edge(best, lo, hi))
+        clog << "Warning: the best collapse is on the edge of the search range, widen it" << endl;
+
+    // Delete-1 fits, searched in the same box as the best one so that their
+    // spread is not cut off. Datasets are independent, so their jackknife
+    // variances add up
+    double var_a = 0, var_b = 0, var_g2c = 0;
+    for(int d=0; d<n_sets; ++d)
+    {
+        int n_jobs = means[d].n_cols;
+        if(n_jobs < 3)
+        {
+            clog << "Warning: dim " << sets[d].dim << " has fewer than 3 jobs, it is left out of the errors" << endl;
+            continue;
+        }
+
+        clog << "dim: " << sets[d].dim << endl;
+
+        vec a_del1(n_jobs), b_del1(n_jobs), g2c_del1(n_jobs);
+        int n_edge = 0;
+        for(int i=0; i<n_jobs; ++i)
+        {
+            vector<CollapseSet> sets_del1 = sets;
+            job_average(means[d], sets_del1[d].y, sets_del1[d].err, i);
+
+            CollapseParams par;
+            collapse_search(sets_del1, lo, hi, par);
+            a_del1(i) = par.a;
+            b_del1(i) = par.b;
+            g2c_del1(i) = par.g2c;
+            n_edge += on_edge(par, lo, hi);
+        }
+        if(n_edge)
+            clog << "Warning: " << n_edge << " delete-1 collapses of dim " << sets[d].dim << " are on the edge of the search range, the errors are underestimated" << endl;
+
+        double avg, var;
+        jackknife_del1(a_del1, avg, var);
+        var_a += var;
+        jackknife_del1(b_del1, avg, var);
+        var_b += var;
+        jackknife_del1(g2c_del1, avg, var);
+        var_g2c += var;
+    }
+
+    // Output fitted parameters
+    string out_filename = out_path + "/" + name + "_collapse.txt";
+    ofstream out_fit;
+    out_fit.open(out_filename);
+
+    if(!out_fit)
+    {
+        cerr << "Error: file " + out_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    out_fit << best.a << " " << sqrt(var_a) << " " << best.b << " " << sqrt(var_b) << " " << best.g2c << " " << sqrt(var_g2c) << " " << quality << endl;
+    out_fit.close();
+
+    //********* END COLLAPSE **********//
+
+
+
+    //********* BEGIN SCALED OUTPUT **********//
+
+    // Same naming as the *_dim_manip drivers
+    for(int d=0; d<n_sets; ++d)
+    {
+        string out_filename_dim = datasets[d] + "/observables/" + name + "_dim" + cc_to_name(best.a) + ".txt";
+        ofstream out_obs_dim(out_filename_dim);
+
+        if(!out_obs_dim)
+        {
+            cerr << "Error: file " + out_filename_dim + " could not be opened." << endl;
+            return 1;
+        }
+
+        vec x, y, err;
+        collapse_scale(sets[d], best, x, y, err);
+        for(unsigned k=0; k<x.n_elem; ++k)
+            out_obs_dim << x(k) << " " << y(k) << " " << err(k) << endl;
+
+        out_obs_dim.close();
+    }
+
+    //********* END SCALED OUTPUT **********//
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <numeric>
+#include <armadillo>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "observables.hpp"
+#include "store.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+using namespace arma;
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 4)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) Name of the observable" << endl;
+        cerr << "3) Coupling constant value" << endl;
+        cerr << "4) (optional) Name of the output files (default the observable name)" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = argv[1];
+    string name = argv[2];
+    double g2_input = stod(argv[3]);
+    string out_name = argc > 4 ? argv[4] : name;
+
+    const Observable* obs = find_observable(name);
+    if(!obs)
+    {
+        cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+        for(const auto& o : observables())
+            cerr << o.name << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN ANALYSIS **********//
+
+    // Cycle on g2 values
+    for(const auto& g2 : ds.g2_vec)
+    {
+        if(std::abs(g2-g2_input) > 1e-8)
+            continue;
+
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        int n_jobs = ds.job_vec.size();
+        vector<char> ok(n_jobs, 1);
+        vector<char> stored(n_jobs, 0);
+        parallel_for(0, n_jobs, [&](int i, int)
+        {
+            // Values come from the store if multi_obs already computed them,
+            // otherwise from the data files
+            vec values;
+            if(read_column(ds, g2, ds.job_vec[i], *obs, values))
+                stored[i] = 1;
+            else
+            {
+                SampleReader reader(ds, g2, ds.job_vec[i], projection(ds, {obs}));
+                if(!reader.is_open())
+                {
+                    ok[i] = 0;
+                    return;
+                }
+
+                Sample smp(ds);
+                values.set_size(reader.size());
+                for(int j=0; j<reader.size(); ++j)
+                {
+                    if(!reader.read(smp))
+                    {
+                        ok[i] = 0;
+                        return;
+                    }
+                    values(j) = obs->f(smp, g2);
+                }
+            }
+
+            // One file per job, one value per line
+            string out_filename = path + "/observables/" + out_name + "_" + to_string(ds.job_vec[i]) + ".txt";
+            ofstream out_obs;
+            out_obs.open(out_filename);
+            if(!out_obs)
+            {
+                ok[i] = 0;
+                return;
+            }
+
+            for(const auto& x : values)
+                out_obs << x << endl;
+            out_obs.close();
+        });
+
+        for(int i=0; i<n_jobs; ++i)
+        {
+            if(!ok[i])
+            {
+                cerr << "Error: couldn't process job " << ds.job_vec[i] << " at g2 " << g2 << endl;
+                return 1;
+            }
+        }
+        clog << "jobs from store: " << accumulate(stored.begin(), stored.end(), 0) << " of " << n_jobs << endl;
+    }
+
+    //********* END ANALYSIS **********//
+
+    return 0;
+}
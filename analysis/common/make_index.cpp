@@ -0,0 +1,93 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include <numeric>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "index.hpp"
+#include "cache.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 2)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "Options: --force to rebuild indices that are up to date" << endl;
+        return 1;
+    }
+
+    // Options can appear anywhere, the rest are positional arguments
+    bool force = false;
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg == "--force")
+            force = true;
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Error: unknown option " + arg << endl;
+            return 1;
+        }
+        else
+            args.push_back(arg);
+    }
+    string path = args.size() ? args[0] : "";
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN INDEXING **********//
+
+    int n_jobs = ds.job_vec.size();
+
+    // Cycle on g2 values
+    for(const auto& g2 : ds.g2_vec)
+    {
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        vector<char> ok(n_jobs, 1);
+        vector<char> fresh(n_jobs, 0);
+        parallel_for(0, n_jobs, [&](int i, int)
+        {
+            FileStamp hl;
+            bool has_hl = file_stamp(data_path(ds, g2, ds.job_vec[i]) + "_HL.txt", hl);
+
+            SampleIndex idx;
+            if(!force && read_index(ds, g2, ds.job_vec[i], has_hl, idx))
+                fresh[i] = 1;
+            else
+                ok[i] = write_index(ds, g2, ds.job_vec[i]);
+        });
+
+        for(int i=0; i<n_jobs; ++i)
+        {
+            if(!ok[i])
+            {
+                cerr << "Error: couldn't index job " << ds.job_vec[i] << " at g2 " << g2 << endl;
+                return 1;
+            }
+        }
+        clog << "jobs already indexed: " << accumulate(fresh.begin(), fresh.end(), 0) << " of " << n_jobs << endl;
+    }
+
+    //********* END INDEXING **********//
+
+    return 0;
+}
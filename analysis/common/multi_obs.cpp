@@ -0,0 +1,452 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <armadillo>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "observables.hpp"
+#include "sketch.hpp"
+#include "accumulator.hpp"
+#include "cache.hpp"
+#include "store.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Tags of cache entries: everything the partial results depend on besides the data
+static string obs_tag(const Observable& obs, int block)
+{
+    return obs.name + " v" + to_string(obs.version) + " block " + to_string(block) + " sum " + to_string(sum_mode()) + (single_precision() ? " single" : "");
+}
+
+static string pair_tag(const Observable& a, const Observable& b)
+{
+    return a.name + " v" + to_string(a.version) + " " + b.name + " v" + to_string(b.version) + (single_precision() ? " single" : "");
+}
+
+// Partial results of one observable for one job
+static void write_entry(ofstream& out, double mean, const JobAcc& ja, const QuantileSketch& quant, const Histogram& hist)
+{
+    out << setprecision(17) << mean << " " << ja.blocks.size() << endl;
+    for(const auto& m : ja.blocks)
+        out << m.n << " " << m.s1 << " " << m.s2 << " " << m.s4 << endl;
+    quant.write(out);
+    hist.write(out);
+}
+
+static bool read_entry(ifstream& in, double& mean, JobAcc& ja, QuantileSketch& quant, Histogram& hist)
+{
+    unsigned n_blocks;
+    if(!(in >> mean >> n_blocks))
+        return false;
+    ja.blocks.resize(n_blocks);
+    for(auto& m : ja.blocks)
+        in >> m.n >> m.s1 >> m.s2 >> m.s4;
+    return in && quant.read(in) && hist.read(in);
+}
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 3)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) A bunch of names of observables" << endl;
+        cerr << "Options: --pair=A:B to also build the joint histogram of A and B," << endl;
+        cerr << "         --block=n to set the samples per block of the accumulator files (default 100)," << endl;
+        cerr << "         --no-cache to ignore and not update the cache of per-job results," << endl;
+        cerr << "         --no-store to not write the per-sample values to the columnar store" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = argv[1];
+    vector<const Observable*> obs_vec;
+    vector<pair<int, int>> pairs;
+    int block = 100;
+    bool use_cache = true;
+    bool use_store = true;
+
+    // Index of an observable in obs_vec, adding it if needed
+    auto obs_index = [&](const string& name)
+    {
+        const Observable* obs = find_observable(name);
+        if(!obs)
+        {
+            cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+            for(const auto& o : observables())
+                cerr << o.name << endl;
+            return -1;
+        }
+        for(unsigned k=0; k<obs_vec.size(); ++k)
+            if(obs_vec[k] == obs)
+                return (int)k;
+        obs_vec.push_back(obs);
+        return (int)obs_vec.size()-1;
+    };
+
+    for(int i=2; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg.compare(0, 7, "--pair=") == 0)
+        {
+            size_t colon = arg.find(':');
+            if(colon == string::npos)
+            {
+                cerr << "Error: option " + arg + " should be --pair=A:B" << endl;
+                return 1;
+            }
+            int a = obs_index(arg.substr(7, colon-7));
+            int b = obs_index(arg.substr(colon+1));
+            if(a < 0 || b < 0)
+                return 1;
+            pairs.push_back(make_pair(a, b));
+        }
+        else if(arg == "--no-cache")
+            use_cache = false;
+        else if(arg == "--no-store")
+            use_store = false;
+        else if(arg.compare(0, 8, "--block=") == 0)
+        {
+            block = stoi(arg.substr(8));
+            if(block < 1)
+            {
+                cerr << "Error: blocks need at least one sample." << endl;
+                return 1;
+            }
+        }
+        else if(obs_index(arg) < 0)
+            return 1;
+    }
+    int n_obs = obs_vec.size();
+    int n_pairs = pairs.size();
+
+    // The store holds double precision values only
+    if(single_precision() && use_store)
+    {
+        clog << "Reading single precision copies, the store is not updated." << endl;
+        use_store = false;
+    }
+
+    // Matrices are only read if some observable needs them
+    bool need_hl = false;
+    for(const auto& obs : obs_vec)
+        need_hl = need_hl || obs->need_hl;
+
+    // The store always gets the action components too, for reweighting
+    vector<const Observable*> extra_vec;
+    for(const auto& name : {"S2", "S4"})
+        if(find(obs_vec.begin(), obs_vec.end(), find_observable(name)) == obs_vec.end())
+            extra_vec.push_back(find_observable(name));
+    int n_extra = extra_vec.size();
+
+    // Quantiles written to the distribution summaries
+    const vector<double> probs = {0.01, 0.05, 0.16, 0.25, 0.5, 0.75, 0.84, 0.95, 0.99};
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN ANALYSIS **********//
+
+
+    // Open output files: mean and error, quantiles and histogram of each observable
+    vector<ofstream> out_obs(n_obs), out_quant(n_obs), out_hist(n_obs);
+    for(int k=0; k<n_obs; ++k)
+    {
+        string base = path + "/observables/" + obs_vec[k]->name;
+        out_obs[k].open(base + ".txt");
+        out_quant[k].open(base + "_quantiles.txt");
+        out_hist[k].open(base + "_hist.txt");
+
+        if(!out_obs[k] || !out_quant[k] || !out_hist[k])
+        {
+            cerr << "Error: output files " + base + "* could not be opened." << endl;
+            return 1;
+        }
+    }
+
+    // Joint histograms of pairs of observables
+    vector<ofstream> out_hist2d(n_pairs);
+    for(int p=0; p<n_pairs; ++p)
+    {
+        string out_filename = path + "/observables/" + obs_vec[pairs[p].first]->name + "_" + obs_vec[pairs[p].second]->name + "_hist2d.txt";
+        out_hist2d[p].open(out_filename);
+
+        if(!out_hist2d[p])
+        {
+            cerr << "Error: file " + out_filename + " could not be opened." << endl;
+            return 1;
+        }
+    }
+
+    int n_jobs = ds.job_vec.size();
+
+    // Only the parts of the samples that are used get decoded
+    vector<const Observable*> read_vec = obs_vec;
+    if(use_store)
+        read_vec.insert(read_vec.end(), extra_vec.begin(), extra_vec.end());
+    Projection proj = projection(ds, read_vec);
+
+    // Per-job results of unchanged files are reused from path/cache
+    if(use_cache && !make_cache_dir(ds))
+        return 1;
+
+    // Per-sample values go to path/store
+    if(use_store && !make_store_dir(ds))
+        return 1;
+
+    // Block sums of every job, for queries on subsets of jobs and samples
+    vector<AccFile> acc(n_obs);
+    for(auto& a : acc)
+        a.block = block;
+
+    // Cycle on g2 values
+    for(const auto& g2 : ds.g2_vec)
+    {
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        // Job means and sketches of each observable, one per job
+        mat samples(n_jobs, n_obs);
+        vector<vector<QuantileSketch>> quant(n_jobs, vector<QuantileSketch>(n_obs));
+        vector<vector<Histogram>> hist(n_jobs, vector<Histogram>(n_obs));
+        vector<vector<Histogram2D>> hist2d(n_pairs, vector<Histogram2D>(n_jobs));
+        vector<vector<JobAcc>> job_acc(n_obs, vector<JobAcc>(n_jobs));
+        vector<char> ok(n_jobs, 1);
+        vector<char> cached(n_jobs, 0);
+        vector<long> n_nonfinite(n_jobs, 0);
+
+        // Every sample is read once and feeds all observables. Threads left
+        // over when there are fewer jobs than threads parse chunks of each file
+        int n_inner = max(1, n_threads()/n_jobs);
+        parallel_for(0, n_jobs, [&](int i, int)
+        {
+            for(int k=0; k<n_obs; ++k)
+            {
+                job_acc[k][i].g2 = g2;
+                job_acc[k][i].job = ds.job_vec[i];
+            }
+
+            // The job is read only if some entry is missing or stale
+            JobCache cache(ds, g2, ds.job_vec[i], need_hl);
+            if(use_cache)
+            {
+                bool hit = true;
+                for(int k=0; k<n_obs && hit; ++k)
+                {
+                    ifstream in;
+                    hit = cache.open(obs_vec[k]->name, obs_tag(*obs_vec[k], block), in) && read_entry(in, samples(i, k), job_acc[k][i], quant[i][k], hist[i][k]);
+                }
+                for(int p=0; p<n_pairs && hit; ++p)
+                {
+                    ifstream in;
+                    const Observable& a = *obs_vec[pairs[p].first];
+                    const Observable& b = *obs_vec[pairs[p].second];
+                    hit = cache.open(a.name + "_" + b.name, pair_tag(a, b), in) && hist2d[p][i].read(in);
+                }
+                for(int k=0; k<n_obs && hit && use_store; ++k)
+                    hit = column_valid(ds, g2, ds.job_vec[i], *obs_vec[k]);
+                for(int k=0; k<n_extra && hit && use_store; ++k)
+                    hit = column_valid(ds, g2, ds.job_vec[i], *extra_vec[k]);
+                if(hit)
+                {
+                    cached[i] = 1;
+                    return;
+                }
+
+                // Start over from empty sketches
+                for(int k=0; k<n_obs; ++k)
+                {
+                    quant[i][k] = QuantileSketch();
+                    hist[i][k] = Histogram();
+                }
+                for(int p=0; p<n_pairs; ++p)
+                    hist2d[p][i] = Histogram2D();
+            }
+
+            ChunkedReader reader(ds, g2, ds.job_vec[i], proj, n_inner);
+            if(!reader.is_open())
+            {
+                ok[i] = 0;
+                return;
+            }
+
+            Sample smp(ds);
+            mat vec_corr(reader.size(), n_obs);
+            mat vec_extra(reader.size(), n_extra);
+            for(int j=0; j<reader.size(); ++j)
+            {
+                if(!reader.read(smp))
+                {
+                    ok[i] = 0;
+                    return;
+                }
+
+                for(int k=0; k<n_obs; ++k)
+                {
+                    double temp = obs_vec[k]->f(smp, g2);
+                    vec_corr(j, k) = temp;
+
+                    // Non-finite values stay out of the distributions
+                    if(hist[i][k].insert(temp))
+                        quant[i][k].insert(temp);
+                    else
+                        ++n_nonfinite[i];
+                }
+
+                for(int p=0; p<n_pairs; ++p)
+                    hist2d[p][i].insert(vec_corr(j, pairs[p].first), vec_corr(j, pairs[p].second));
+
+                if(use_store)
+                    for(int k=0; k<n_extra; ++k)
+                        vec_extra(j, k) = extra_vec[k]->f(smp, g2);
+            }
+
+            for(int k=0; k<n_obs; ++k)
+            {
+                SumAccumulator temp;
+                JobAcc& ja = job_acc[k][i];
+                ja.blocks.assign((reader.size() + block-1)/block, Moments());
+                for(int j=0; j<reader.size(); ++j)
+                {
+                    temp.add(vec_corr(j, k));
+                    ja.blocks[j/block].add(vec_corr(j, k));
+                }
+                samples(i, k) = temp.result()/reader.size();
+            }
+
+            // Store and cache are only optimizations, entries that can't be written are skipped
+            if(use_store)
+            {
+                vec column(reader.size());
+                for(int k=0; k<n_obs; ++k)
+                {
+                    for(int j=0; j<reader.size(); ++j)
+                        column(j) = vec_corr(j, k);
+                    write_column(ds, g2, ds.job_vec[i], *obs_vec[k], column);
+                }
+                for(int k=0; k<n_extra; ++k)
+                {
+                    for(int j=0; j<reader.size(); ++j)
+                        column(j) = vec_extra(j, k);
+                    write_column(ds, g2, ds.job_vec[i], *extra_vec[k], column);
+                }
+            }
+            if(use_cache)
+            {
+                for(int k=0; k<n_obs; ++k)
+                {
+                    ofstream out;
+                    if(cache.create(obs_vec[k]->name, obs_tag(*obs_vec[k], block), out))
+                        write_entry(out, samples(i, k), job_acc[k][i], quant[i][k], hist[i][k]);
+                }
+                for(int p=0; p<n_pairs; ++p)
+                {
+                    ofstream out;
+                    const Observable& a = *obs_vec[pairs[p].first];
+                    const Observable& b = *obs_vec[pairs[p].second];
+                    if(cache.create(a.name + "_" + b.name, pair_tag(a, b), out))
+                        hist2d[p][i].write(out);
+                }
+            }
+        });
+
+        for(int i=0; i<n_jobs; ++i)
+        {
+            if(!ok[i])
+            {
+                cerr << "Error: couldn't read job " << ds.job_vec[i] << " at g2 " << g2 << endl;
+                return 1;
+            }
+        }
+        long n_bad = accumulate(n_nonfinite.begin(), n_nonfinite.end(), 0L);
+        if(n_bad)
+            clog << "Warning: " << n_bad << " non-finite values at g2 " << g2 << " are left out of the quantiles and histograms" << endl;
+        if(use_cache)
+            clog << "jobs from cache: " << accumulate(cached.begin(), cached.end(), 0) << " of " << n_jobs << endl;
+
+        for(int k=0; k<n_obs; ++k)
+        {
+            // Output mean and error of observable
+            vec samples_k(n_jobs);
+            for(int i=0; i<n_jobs; ++i)
+                samples_k(i) = samples(i, k);
+
+            // A single job has no error estimate
+            double avg = 0;
+            double var = 0;
+            double err = 0;
+            if(n_jobs > 1)
+            {
+                jackknife(samples_k, avg, var, my_mean);
+                err = sqrt(var);
+            }
+            else
+                avg = samples_k(0);
+            out_obs[k] << g2 << " " << avg << " " << err << endl;
+
+            // Merge sketches in job order, so that the result does not
+            // depend on which thread finished first
+            QuantileSketch quant_tot;
+            Histogram hist_tot;
+            for(int i=0; i<n_jobs; ++i)
+            {
+                quant_tot.merge(quant[i][k]);
+                hist_tot.merge(hist[i][k]);
+            }
+
+            out_quant[k] << g2;
+            for(const auto& p : probs)
+                out_quant[k] << " " << quant_tot.quantile(p);
+            out_quant[k] << endl;
+
+            hist_tot.print(out_hist[k], g2);
+
+            acc[k].jobs.insert(acc[k].jobs.end(), job_acc[k].begin(), job_acc[k].end());
+        }
+
+        // Joint histograms, with jackknife errors over jobs in every bin
+        for(int p=0; p<n_pairs; ++p)
+        {
+            Histogram2D hist2d_tot;
+            for(int i=0; i<n_jobs; ++i)
+                hist2d_tot.merge(hist2d[p][i]);
+            hist2d_tot.print(out_hist2d[p], g2, hist2d[p]);
+        }
+    }
+
+    for(int k=0; k<n_obs; ++k)
+    {
+        out_obs[k].close();
+        out_quant[k].close();
+        out_hist[k].close();
+    }
+    for(int p=0; p<n_pairs; ++p)
+        out_hist2d[p].close();
+
+    for(int k=0; k<n_obs; ++k)
+        if(!write_acc(acc_filename(path, obs_vec[k]->name), acc[k]))
+            return 1;
+
+    //********* END ANALYSIS **********//
+
+    return 0;
+}
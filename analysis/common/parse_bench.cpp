@@ -0,0 +1,173 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <armadillo>
+#include "geometry.hpp"
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "cache.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Open the files of a job and skip the burn-in, as the legacy drivers do
+static bool open_legacy(const Dataset& ds, double g2, int job, ifstream& in_s, ifstream& in_hl)
+{
+    string filename = data_path(ds, g2, job);
+    in_s.open(filename + "_S.txt");
+    in_hl.open(filename + "_HL.txt");
+    if(!in_s || !in_hl)
+        return false;
+
+    int cut = burnin_cut(ds, g2, job);
+    skip_s(in_s, cut);
+    skip_hl(in_hl, cut, ds.sm);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 4)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) Coupling constant value" << endl;
+        cerr << "3) Job number" << endl;
+        cerr << "4) (optional) Number of repetitions (default 1)" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = argv[1];
+    double g2 = stod(argv[2]);
+    int job = stoi(argv[3]);
+    int n_rep = argc > 4 ? stoi(argv[4]) : 1;
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    string filename = data_path(ds, g2, job);
+    FileStamp st_s, st_hl;
+    if(!file_stamp(filename + "_S.txt", st_s) || !file_stamp(filename + "_HL.txt", st_hl))
+    {
+        cerr << "Error: files " + filename + "_S.txt and _HL.txt could not be opened." << endl;
+        return 1;
+    }
+    double mb = n_rep*(st_s.size + st_hl.size)/1e6;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN BENCHMARK **********//
+
+    int n = ds.sm.samples - min(burnin_cut(ds, g2, job), ds.sm.samples);
+    Geom24 G(ds.sm.p, ds.sm.q, ds.sm.dim, g2);
+    Sample smp(ds);
+    double S2, S4;
+
+    // Stream extraction through Geom24. The speedup is only meaningful with
+    // the Geom24 of RFLmain and files written by the simulation, since the
+    // parsing cost depends on how the numbers were printed
+    auto start = chrono::steady_clock::now();
+    for(int r=0; r<n_rep; ++r)
+    {
+        ifstream in_s, in_hl;
+        if(!open_legacy(ds, g2, job, in_s, in_hl))
+            return 1;
+        for(int j=0; j<n; ++j)
+        {
+            in_s >> S2 >> S4;
+            G.read_mat(in_hl);
+        }
+    }
+    double t_legacy = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Block reads and the dedicated parser
+    start = chrono::steady_clock::now();
+    for(int r=0; r<n_rep; ++r)
+    {
+        SampleReader reader(ds, g2, job);
+        if(!reader.is_open())
+            return 1;
+        for(int j=0; j<n; ++j)
+        {
+            if(!reader.read(smp))
+            {
+                cerr << "Error: sample " << j << " could not be read." << endl;
+                return 1;
+            }
+        }
+    }
+    double t_fast = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // The same parser on chunks of the file, one per thread
+    int n_thr = n_threads();
+    start = chrono::steady_clock::now();
+    for(int r=0; r<n_rep; ++r)
+    {
+        ChunkedReader reader(ds, g2, job, true, n_thr);
+        if(!reader.is_open())
+            return 1;
+        for(int j=0; j<n; ++j)
+        {
+            if(!reader.read(smp))
+            {
+                cerr << "Error: sample " << j << " could not be read." << endl;
+                return 1;
+            }
+        }
+    }
+    double t_chunked = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Both have to give the same bits
+    ifstream in_s, in_hl;
+    open_legacy(ds, g2, job, in_s, in_hl);
+    SampleReader reader(ds, g2, job);
+    long long n_diff = 0;
+    double max_diff = 0;
+    for(int j=0; j<n; ++j)
+    {
+        in_s >> S2 >> S4;
+        G.read_mat(in_hl);
+        reader.read(smp);
+        n_diff += (S2 != smp.S2) + (S4 != smp.S4);
+        for(int i=0; i<G.get_nHL(); ++i)
+        {
+            const cx_mat& M = G.get_mat(i);
+            for(int k=0; k<ds.sm.dim; ++k)
+            {
+                for(int l=0; l<ds.sm.dim; ++l)
+                {
+                    if(M(k,l) != smp.mat[i](k,l))
+                    {
+                        ++n_diff;
+                        max_diff = max(max_diff, std::abs(M(k,l) - smp.mat[i](k,l)));
+                    }
+                }
+            }
+        }
+    }
+
+    cout << "samples: " << n << " x " << n_rep << ", " << mb << " MB" << endl;
+    cout << "read_mat: " << t_legacy << " s, " << mb/t_legacy << " MB/s" << endl;
+    cout << "SampleReader: " << t_fast << " s, " << mb/t_fast << " MB/s" << endl;
+    cout << "speedup: " << t_legacy/t_fast << endl;
+    cout << "ChunkedReader (" << n_thr << " threads): " << t_chunked << " s, " << mb/t_chunked << " MB/s" << endl;
+    cout << "differing values: " << n_diff << " (max " << max_diff << ")" << endl;
+
+    //********* END BENCHMARK **********//
+
+    return n_diff ? 1 : 0;
+}
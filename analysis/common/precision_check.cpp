@@ -0,0 +1,223 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <armadillo>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "binary.hpp"
+#include "observables.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Deviations of one observable on one job
+struct Deviation
+{
+    double abs;
+    double rel;
+    double mean;
+
+    Deviation() : abs(0), rel(0), mean(0) {}
+};
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 3)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) A bunch of names of observables" << endl;
+        cerr << "Options: --jobs=n to check only n jobs per g2, spread over the job list (default all)" << endl;
+        return 1;
+    }
+
+    // Options can appear anywhere, the rest are positional arguments
+    int max_jobs = 0;
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg.compare(0, 7, "--jobs=") == 0)
+            max_jobs = stoi(arg.substr(7));
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Error: unknown option " + arg << endl;
+            return 1;
+        }
+        else
+            args.push_back(arg);
+    }
+    string path = args.size() ? args[0] : "";
+
+    vector<const Observable*> obs_vec;
+    for(unsigned a=1; a<args.size(); ++a)
+    {
+        const Observable* obs = find_observable(args[a]);
+        if(!obs)
+        {
+            cerr << "Error: observable " + args[a] + " is not registered. Available observables:" << endl;
+            for(const auto& o : observables())
+                cerr << o.name << endl;
+            return 1;
+        }
+        obs_vec.push_back(obs);
+    }
+    int n_obs = obs_vec.size();
+
+    if(!n_obs)
+    {
+        cerr << "Error: no observables to check." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN ANALYSIS **********//
+
+
+    // Open output file
+    string out_filename = path + "/observables/precision.txt";
+    ofstream out_obs;
+    out_obs.open(out_filename);
+
+    if(!out_obs)
+    {
+        cerr << "Error: file " + out_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    // Same parts of the samples read in both precisions
+    Projection proj_d = projection(ds, obs_vec);
+    Projection proj_s = proj_d;
+    proj_d.single = false;
+    proj_s.single = true;
+
+    // Jobs spread over the whole list
+    int n_jobs = ds.job_vec.size();
+    vector<int> jobs = bit_reversed_order(n_jobs);
+    if(max_jobs > 0 && max_jobs < n_jobs)
+        jobs.resize(max_jobs);
+    int n_check = jobs.size();
+
+    vector<Deviation> worst(n_obs);
+
+    // Cycle on g2 values
+    for(const auto& g2 : ds.g2_vec)
+    {
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        vector<vector<Deviation>> dev(n_check, vector<Deviation>(n_obs));
+        vector<char> ok(n_check, 1);
+        vector<char> missing(n_check, 0);
+        parallel_for(0, n_check, [&](int c, int)
+        {
+            int job = ds.job_vec[jobs[c]];
+
+            // Without a single precision copy both readers would give the same values
+            BinaryReader bin;
+            if(!bin.open(ds, g2, job, proj_s, true))
+            {
+                missing[c] = 1;
+                return;
+            }
+
+            SampleReader in_d(ds, g2, job, proj_d);
+            SampleReader in_s(ds, g2, job, proj_s);
+            if(!in_d.is_open() || !in_s.is_open() || in_d.size() != in_s.size() || in_d.size() < 2)
+            {
+                ok[c] = 0;
+                return;
+            }
+
+            int n = in_d.size();
+            Sample smp_d(ds), smp_s(ds);
+            vector<vec> val_d(n_obs, vec(n)), val_s(n_obs, vec(n));
+            for(int j=0; j<n; ++j)
+            {
+                if(!in_d.read(smp_d) || !in_s.read(smp_s))
+                {
+                    ok[c] = 0;
+                    return;
+                }
+                for(int k=0; k<n_obs; ++k)
+                {
+                    val_d[k](j) = obs_vec[k]->f(smp_d, g2);
+                    val_s[k](j) = obs_vec[k]->f(smp_s, g2);
+                    double d = fabs(val_s[k](j) - val_d[k](j));
+                    dev[c][k].abs = max(dev[c][k].abs, d);
+                    if(val_d[k](j) != 0)
+                        dev[c][k].rel = max(dev[c][k].rel, d/fabs(val_d[k](j)));
+                }
+            }
+
+            // Shift of the job mean in units of its statistical error
+            for(int k=0; k<n_obs; ++k)
+            {
+                double err = stddev(val_d[k])/sqrt(n);
+                double shift = fabs(reduce_mean(val_s[k], SUM_NEUMAIER) - reduce_mean(val_d[k], SUM_NEUMAIER));
+                dev[c][k].mean = err > 0 ? shift/err : (shift > 0 ? HUGE_VAL : 0);
+            }
+        });
+
+        for(int c=0; c<n_check; ++c)
+        {
+            int job = ds.job_vec[jobs[c]];
+            if(missing[c])
+            {
+                cerr << "Error: no single precision copy of job " << job << " at g2 " << g2 << ", run to_binary --single first." << endl;
+                return 1;
+            }
+            if(!ok[c])
+            {
+                cerr << "Error: couldn't read job " << job << " at g2 " << g2 << endl;
+                return 1;
+            }
+        }
+
+        // Columns are observable, g2, largest absolute and relative deviation
+        // of a sample, largest shift of a job mean over its error
+        for(int k=0; k<n_obs; ++k)
+        {
+            Deviation d;
+            for(int c=0; c<n_check; ++c)
+            {
+                d.abs = max(d.abs, dev[c][k].abs);
+                d.rel = max(d.rel, dev[c][k].rel);
+                d.mean = max(d.mean, dev[c][k].mean);
+            }
+            out_obs << obs_vec[k]->name << " " << g2 << " " << d.abs << " " << d.rel << " " << d.mean << endl;
+
+            worst[k].abs = max(worst[k].abs, d.abs);
+            worst[k].rel = max(worst[k].rel, d.rel);
+            worst[k].mean = max(worst[k].mean, d.mean);
+        }
+    }
+
+    out_obs.close();
+
+    // Summary over all couplings
+    for(int k=0; k<n_obs; ++k)
+        clog << obs_vec[k]->name << ": max deviation " << worst[k].abs << " (relative " << worst[k].rel << "), mean shift " << worst[k].mean << " errors" << endl;
+
+    //********* END ANALYSIS **********//
+
+    return 0;
+}
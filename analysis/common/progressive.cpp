@@ -0,0 +1,305 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <armadillo>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "observables.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Samples of one job at one g2 seen so far
+struct JobState
+{
+    SampleIndex idx;
+    vector<int> order;
+    vec values;
+    int n_done;
+};
+
+// Latest estimate at one g2
+struct Estimate
+{
+    double avg, err;
+    int n_used, n_tot;
+    int n_met;
+    bool done;
+};
+
+// Parse an option of the form --key=value
+static bool parse_option(const string& arg, const string& key, double& value)
+{
+    string head = "--" + key + "=";
+    if(arg.compare(0, head.size(), head) != 0)
+        return false;
+
+    value = stod(arg.substr(head.size()));
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    // Options can appear anywhere, the rest are positional arguments
+    double tol_abs = 0, tol_rel = 0;
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(parse_option(arg, "abs", tol_abs) || parse_option(arg, "rel", tol_rel))
+            continue;
+        args.push_back(arg);
+    }
+
+    // Check arguments
+    if(args.size() < 2)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) Name of the observable" << endl;
+        cerr << "3) (optional) Number of refreshed estimates (default 8)" << endl;
+        cerr << "Options: --abs=x to stop a g2 value once the error is below x," << endl;
+        cerr << "         --rel=x to stop it once the error is below x times the mean" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = args[0];
+    string name = args[1];
+    int n_refresh = args.size() > 2 ? stoi(args[2]) : 8;
+    bool early_stop = tol_abs > 0 || tol_rel > 0;
+
+    // Samples per job needed before trusting the batch error,
+    // and consecutive estimates that must meet the target
+    const int min_samples = 20;
+    const int min_met = 2;
+
+    const Observable* obs = find_observable(name);
+    if(!obs)
+    {
+        cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+        for(const auto& o : observables())
+            cerr << o.name << endl;
+        return 1;
+    }
+
+    if(n_refresh < 1)
+    {
+        cerr << "Error: need at least one estimate." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN ANALYSIS **********//
+
+    int n_g2 = ds.g2_vec.size();
+    int n_jobs = ds.job_vec.size();
+    vector<vector<JobState>> state(n_g2, vector<JobState>(n_jobs));
+    vector<Estimate> est(n_g2, Estimate{0, 0, 0, 0, 0, false});
+
+    // Every estimate is also appended here, with the fraction of samples used
+    string progress_filename = path + "/observables/" + name + "_progress.txt";
+    ofstream out_progress;
+    out_progress.open(progress_filename);
+
+    if(!out_progress)
+    {
+        cerr << "Error: file " + progress_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    // Estimate r uses a fraction 2^(r+1-n_refresh) of the samples of every
+    // job, taken in bit-reversed order so that they span the whole chain
+    for(int r=0; r<n_refresh; ++r)
+    {
+        double frac = ldexp(1., r+1-n_refresh);
+        clog << "fraction: " << frac << endl;
+
+        for(int a=0; a<n_g2; ++a)
+        {
+            // Time goes to the g2 values that still need it
+            if(est[a].done)
+                continue;
+
+            double g2 = ds.g2_vec[a];
+
+            vector<char> ok(n_jobs, 1);
+            vec samples(n_jobs);
+            vec samples_err(n_jobs);
+            ivec n_done(n_jobs);
+            parallel_for(0, n_jobs, [&](int i, int)
+            {
+                JobState& st = state[a][i];
+                SampleReader reader(ds, g2, ds.job_vec[i], projection(ds, {obs}));
+                if(!reader.is_open())
+                {
+                    ok[i] = 0;
+                    return;
+                }
+
+                // Offsets are found once, on the first visit
+                if(r == 0)
+                {
+                    if(!reader.build_index(st.idx))
+                    {
+                        ok[i] = 0;
+                        return;
+                    }
+                    st.order = bit_reversed_order(reader.size());
+                    st.values.set_size(reader.size());
+                    st.n_done = 0;
+                }
+
+                int n = reader.size();
+                int n_next = (r == n_refresh-1) ? n : (int)ceil(frac*n);
+
+                // New samples of this round, read in file order
+                vector<int> todo(st.order.begin()+st.n_done, st.order.begin()+n_next);
+                sort(todo.begin(), todo.end());
+
+                Sample smp(ds);
+                for(const auto& j : todo)
+                {
+                    if(!reader.seek(st.idx, j) || !reader.read(smp))
+                    {
+                        ok[i] = 0;
+                        return;
+                    }
+                    st.values(j) = obs->f(smp, g2);
+                }
+                st.n_done = n_next;
+                n_done(i) = st.n_done;
+
+                // Once every sample is in, this is the same mean as a full pass
+                if(st.n_done == n)
+                {
+                    samples(i) = reduce_mean(st.values);
+                    samples_err(i) = batch_err(st.values);
+                    return;
+                }
+
+                // Samples seen so far, in file order, for the batch error
+                vector<int> seen(st.order.begin(), st.order.begin()+st.n_done);
+                sort(seen.begin(), seen.end());
+                vec vec_corr(seen.size());
+                for(unsigned k=0; k<seen.size(); ++k)
+                    vec_corr(k) = st.values(seen[k]);
+                samples(i) = reduce_mean(vec_corr);
+                samples_err(i) = batch_err(vec_corr);
+            });
+
+            for(int i=0; i<n_jobs; ++i)
+            {
+                if(!ok[i])
+                {
+                    cerr << "Error: couldn't read job " << ds.job_vec[i] << " at g2 " << g2 << endl;
+                    return 1;
+                }
+            }
+
+            // Mean and error of observable, a single job has no error estimate
+            double avg = 0;
+            double var = 0;
+            double err = 0;
+            if(n_jobs > 1)
+            {
+                jackknife(samples, avg, var, my_mean);
+                err = sqrt(var);
+            }
+            else
+                avg = samples(0);
+
+            Estimate& e = est[a];
+            e.avg = avg;
+            e.err = err;
+            e.n_used = accu(n_done);
+            e.n_tot = 0;
+            for(int i=0; i<n_jobs; ++i)
+                e.n_tot += state[a][i].values.n_elem;
+            e.done = (e.n_used == e.n_tot);
+            out_progress << frac << " " << g2 << " " << avg << " " << err << endl;
+
+            // The error used for stopping is the larger of the jackknife over
+            // jobs and the one propagated from the batch errors of the job means,
+            // which accounts for autocorrelations within each job
+            if(early_stop && !e.done)
+            {
+                double err_samples = sqrt(accu(square(samples_err)))/n_jobs;
+                double err_stop = std::max(err, err_samples);
+                bool met = n_done.min() >= min_samples;
+                if(tol_abs > 0)
+                    met = met && err_stop <= tol_abs;
+                if(tol_rel > 0)
+                    met = met && err_stop <= tol_rel*std::abs(avg);
+
+                e.n_met = met ? e.n_met+1 : 0;
+                if(e.n_met >= min_met)
+                {
+                    e.done = true;
+                    clog << "g2 " << g2 << " reached the target with " << e.n_used << " of " << e.n_tot << " samples" << endl;
+                }
+            }
+        }
+
+        // Output latest estimates, rewritten every time so they can be plotted at any time
+        string out_filename = path + "/observables/" + name + ".txt";
+        ofstream out_obs;
+        out_obs.open(out_filename);
+
+        if(!out_obs)
+        {
+            cerr << "Error: file " + out_filename + " could not be opened." << endl;
+            return 1;
+        }
+
+        for(int a=0; a<n_g2; ++a)
+            out_obs << ds.g2_vec[a] << " " << est[a].avg << " " << est[a].err << endl;
+        out_obs.close();
+
+        bool all_done = true;
+        for(const auto& e : est)
+            all_done = all_done && e.done;
+        if(all_done)
+            break;
+    }
+
+    out_progress.close();
+
+    // Samples behind each estimate, summed over jobs
+    string samples_filename = path + "/observables/" + name + "_samples.txt";
+    ofstream out_samples;
+    out_samples.open(samples_filename);
+
+    if(!out_samples)
+    {
+        cerr << "Error: file " + samples_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    for(int a=0; a<n_g2; ++a)
+        out_samples << ds.g2_vec[a] << " " << est[a].n_used << " " << est[a].n_tot << endl;
+    out_samples.close();
+
+    //********* END ANALYSIS **********//
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <armadillo>
+#include "dataset.hpp"
+#include "observables.hpp"
+#include "reweight.hpp"
+#include "parallel.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 4)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) Name of the observable" << endl;
+        cerr << "3) Number of reweighted points between neighbouring g2 values" << endl;
+        cerr << "4) (optional) Minimum effective sample size, as a fraction of the samples (default 0.1)" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = argv[1];
+    string name = argv[2];
+    int n_pts = stoi(argv[3]);
+    double ess_min = argc > 4 ? stod(argv[4]) : 0.1;
+
+    const Observable* obs = find_observable(name);
+    if(!obs)
+    {
+        cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+        for(const auto& o : observables())
+            cerr << o.name << endl;
+        return 1;
+    }
+
+    if(n_pts < 1)
+    {
+        cerr << "Error: need at least one reweighted point between g2 values." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN ANALYSIS **********//
+
+
+    // Open output file
+    string out_filename = path + "/observables/" + name + "_rw.txt";
+    ofstream out_obs;
+    out_obs.open(out_filename);
+
+    if(!out_obs)
+    {
+        cerr << "Error: file " + out_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    int n_g2 = ds.g2_vec.size();
+
+    // Cycle on simulated g2 values
+    for(int a=0; a<n_g2; ++a)
+    {
+        double g2 = ds.g2_vec[a];
+
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        // Samples of each job are read once and reweighted many times
+        vector<RwJob> jobs;
+        if(!load_rw_jobs(ds, g2, *obs, jobs))
+            return 1;
+
+        double n_tot = 0;
+        for(const auto& job : jobs)
+            n_tot += job.S2.n_elem;
+
+        // Reweight up to half way to the neighbouring g2 values
+        // (the outermost points use the distance to their only neighbour)
+        double h_left = 0, h_right = 0;
+        if(n_g2 > 1)
+        {
+            h_left = 0.5*(a > 0 ? g2 - ds.g2_vec[a-1] : ds.g2_vec[a+1] - g2);
+            h_right = 0.5*(a < n_g2-1 ? ds.g2_vec[a+1] - g2 : g2 - ds.g2_vec[a-1]);
+        }
+
+        int n_grid = 2*n_pts + 1;
+        vec g2p(n_grid);
+        for(int k=-n_pts; k<=n_pts; ++k)
+            g2p(k+n_pts) = g2 + k*(k < 0 ? h_left : h_right)/n_pts;
+
+        // Grid points are independent, compute them in parallel
+        mat res(n_grid, 5);
+        parallel_for(0, n_grid, [&](int k, int)
+        {
+            mat sums;
+            reweight_sums(jobs, g2, g2p(k), *obs, sums);
+
+            rowvec total = sum(sums, 0);
+
+            double avg = 0, var = 0, sus = 0, var_sus = 0;
+            if(jobs.size() > 1)
+            {
+                jackknife_sums(sums, avg, var, rw_mean);
+                jackknife_sums(sums, sus, var_sus, rw_sus);
+            }
+            else
+            {
+                avg = rw_mean(total);
+                sus = rw_sus(total);
+            }
+
+            res(k,0) = avg;
+            res(k,1) = sqrt(var);
+            res(k,2) = sus;
+            res(k,3) = sqrt(var_sus);
+            res(k,4) = rw_ess(total)/n_tot;
+        });
+
+        // Output only the points where the reweighting is reliable, columns are
+        // g2, mean, error, susceptibility, error, ESS fraction, simulated g2
+        for(int k=0; k<n_grid; ++k)
+        {
+            if(res(k,4) < ess_min)
+            {
+                clog << "g2 " << g2p(k) << " skipped: effective sample size fraction " << res(k,4) << endl;
+                continue;
+            }
+            out_obs << g2p(k) << " " << res(k,0) << " " << res(k,1) << " " << res(k,2) << " " << res(k,3) << " " << res(k,4) << " " << g2 << endl;
+        }
+    }
+
+    out_obs.close();
+
+    //********* END ANALYSIS **********//
+
+    return 0;
+}
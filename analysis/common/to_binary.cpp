@@ -0,0 +1,156 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <vector>
+#include <numeric>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "binary.hpp"
+#include "compress.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 2)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "Options: --packed to keep only the upper triangle of the (anti-)Hermitian matrices," << endl;
+        cerr << "         --force to rewrite binary copies that are up to date," << endl;
+        cerr << "         --verify to only compare the existing copies with the text files," << endl;
+        cerr << "         --compressed to write (or verify) the chunked compressed copies instead," << endl;
+        cerr << "         --chunk=k for the samples per chunk of the compressed copies (default 64)," << endl;
+        cerr << "         --single to write (or verify) single precision binary copies instead" << endl;
+        return 1;
+    }
+
+    // Options can appear anywhere, the rest are positional arguments
+    bool force = false;
+    bool packed = false;
+    bool verify = false;
+    bool compressed = false;
+    bool single = false;
+    int chunk = 64;
+    vector<string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg == "--force")
+            force = true;
+        else if(arg == "--packed")
+            packed = true;
+        else if(arg == "--verify")
+            verify = true;
+        else if(arg == "--compressed")
+            compressed = true;
+        else if(arg == "--single")
+            single = true;
+        else if(arg.compare(0, 8, "--chunk=") == 0)
+            chunk = stoi(arg.substr(8));
+        else if(arg.compare(0, 2, "--") == 0)
+        {
+            cerr << "Error: unknown option " + arg << endl;
+            return 1;
+        }
+        else
+            args.push_back(arg);
+    }
+    string path = args.size() ? args[0] : "";
+
+    if(compressed && single)
+    {
+        cerr << "Error: compressed copies are always in double precision." << endl;
+        return 1;
+    }
+
+    if(chunk < 1)
+    {
+        cerr << "Error: chunks need at least one sample." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN CONVERSION **********//
+
+    int n_jobs = ds.job_vec.size();
+
+    // Cycle on g2 values
+    for(const auto& g2 : ds.g2_vec)
+    {
+        // Print value of g2 being processed
+        clog << "g2: " << g2 << endl;
+
+        vector<char> ok(n_jobs, 1);
+        vector<char> fresh(n_jobs, 0);
+        vector<char> full(n_jobs, 0);
+        vector<long long> n_diff(n_jobs, 0);
+        vector<double> ratio(n_jobs, 0);
+        parallel_for(0, n_jobs, [&](int i, int)
+        {
+            int job = ds.job_vec[i];
+            if(verify)
+            {
+                ok[i] = compressed ? verify_compressed(ds, g2, job, n_diff[i]) : verify_binary(ds, g2, job, n_diff[i], single);
+                return;
+            }
+
+            BinaryReader bin;
+            CompressedReader zip;
+            bool packed_i = packed;
+            if(!force && !compressed && bin.open(ds, g2, job, full_projection(ds), single) && (!packed || bin.is_packed()))
+                fresh[i] = 1;
+            else if(!force && compressed && zip.open(ds, g2, job, full_projection(ds)) && (!packed || zip.is_packed()))
+                fresh[i] = 1;
+            else
+            {
+                ok[i] = compressed ? write_compressed(ds, g2, job, chunk, packed_i, ratio[i]) : write_binary(ds, g2, job, packed_i, single);
+                full[i] = packed && !packed_i;
+            }
+        });
+
+        for(int i=0; i<n_jobs; ++i)
+        {
+            if(!ok[i])
+            {
+                cerr << "Error: couldn't " << (verify ? "verify" : "convert") << " job " << ds.job_vec[i] << " at g2 " << g2 << endl;
+                return 1;
+            }
+        }
+
+        if(verify)
+        {
+            long long tot = accumulate(n_diff.begin(), n_diff.end(), 0LL);
+            clog << "differing values: " << tot << endl;
+            if(tot)
+                return 1;
+            continue;
+        }
+
+        clog << "jobs already converted: " << accumulate(fresh.begin(), fresh.end(), 0) << " of " << n_jobs << endl;
+        if(packed)
+            clog << "jobs not exactly (anti-)Hermitian, written in full: " << accumulate(full.begin(), full.end(), 0) << endl;
+
+        // Size of the new compressed copies relative to full binary ones
+        int n_new = n_jobs - accumulate(fresh.begin(), fresh.end(), 0);
+        if(compressed && n_new)
+            clog << "compression ratio: " << accumulate(ratio.begin(), ratio.end(), 0.)/n_new << endl;
+    }
+
+    //********* END CONVERSION **********//
+
+    return 0;
+}
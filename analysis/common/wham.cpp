@@ -0,0 +1,172 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <armadillo>
+#include "dataset.hpp"
+#include "observables.hpp"
+#include "reweight.hpp"
+#include "parallel.hpp"
+#include "statistics.hpp"
+
+using namespace std;
+using namespace arma;
+
+int main(int argc, char** argv)
+{
+    // Check arguments
+    if(argc < 4)
+    {
+        cerr << "Need to pass:" << endl;
+        cerr << "1) Path to folder containing the data" << endl;
+        cerr << "2) Name of the observable" << endl;
+        cerr << "3) Number of output g2 values over the whole range" << endl;
+        cerr << "4) (optional) Tolerance on the free energies (default 1e-10)" << endl;
+        return 1;
+    }
+
+    // Some declarations for later
+    string path = argv[1];
+    string name = argv[2];
+    int n_out = stoi(argv[3]);
+    double tol = argc > 4 ? stod(argv[4]) : 1e-10;
+
+    const Observable* obs = find_observable(name);
+    if(!obs)
+    {
+        cerr << "Error: observable " + name + " is not registered. Available observables:" << endl;
+        for(const auto& o : observables())
+            cerr << o.name << endl;
+        return 1;
+    }
+
+    if(n_out < 2)
+    {
+        cerr << "Error: need at least two output g2 values." << endl;
+        return 1;
+    }
+
+
+
+    //********* BEGIN DATASET INITIALIZATION **********//
+
+    Dataset ds;
+    if(!read_dataset(path, ds))
+        return 1;
+
+    // S2 and the observable of every sample are read once and kept in memory
+    WhamData data;
+    if(!load_wham_data(ds, *obs, data))
+        return 1;
+
+    cout << "Loaded " << data.S2.n_elem << " samples" << endl;
+
+    //********* END DATASET INITIALIZATION **********//
+
+
+
+    //********* BEGIN FREE ENERGIES **********//
+
+    vec f;
+    int iter = wham_solve(data, f, -1, tol);
+    if(iter < 0)
+    {
+        cerr << "Error: multi-histogram equations did not converge." << endl;
+        return 1;
+    }
+    cout << "Free energies converged in " << iter << " iterations" << endl;
+
+    // Delete-1 solutions start from the full one and converge quickly
+    vector<vec> f_del1(data.n_jobs, f);
+    if(data.n_jobs > 1)
+    {
+        for(int i=0; i<data.n_jobs; ++i)
+        {
+            clog << "job: " << ds.job_vec[i] << endl;
+            if(wham_solve(data, f_del1[i], i, tol) < 0)
+            {
+                cerr << "Error: multi-histogram equations without job " << ds.job_vec[i] << " did not converge." << endl;
+                return 1;
+            }
+        }
+    }
+
+    // Output free energies
+    string f_filename = path + "/observables/wham_f.txt";
+    ofstream out_f;
+    out_f.open(f_filename);
+
+    if(!out_f)
+    {
+        cerr << "Error: file " + f_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    out_f << setprecision(16);
+    for(unsigned b=0; b<data.g2.size(); ++b)
+        out_f << data.g2[b] << " " << f(b) << endl;
+    out_f.close();
+
+    //********* END FREE ENERGIES **********//
+
+
+
+    //********* BEGIN ANALYSIS **********//
+
+
+    // Open output file
+    string out_filename = path + "/observables/" + name + "_wham.txt";
+    ofstream out_obs;
+    out_obs.open(out_filename);
+
+    if(!out_obs)
+    {
+        cerr << "Error: file " + out_filename + " could not be opened." << endl;
+        return 1;
+    }
+
+    double g2_min = *min_element(data.g2.begin(), data.g2.end());
+    double g2_max = *max_element(data.g2.begin(), data.g2.end());
+
+    // Cycle on output g2 values, columns are
+    // g2, mean, error, susceptibility, error, ESS fraction
+    for(int k=0; k<n_out; ++k)
+    {
+        double g2p = g2_min + k*(g2_max-g2_min)/(n_out-1);
+
+        mat sums;
+        wham_sums(data, f, g2p, *obs, sums);
+        rowvec total = sum(sums, 0);
+
+        double avg = rw_mean(total);
+        double sus = rw_sus(total);
+        double var = 0, var_sus = 0;
+
+        if(data.n_jobs > 1)
+        {
+            vec avg_del1(data.n_jobs);
+            vec sus_del1(data.n_jobs);
+            for(int i=0; i<data.n_jobs; ++i)
+            {
+                mat sums_del1;
+                wham_sums(data, f_del1[i], g2p, *obs, sums_del1, i);
+                rowvec total_del1 = sum(sums_del1, 0);
+                avg_del1(i) = rw_mean(total_del1);
+                sus_del1(i) = rw_sus(total_del1);
+            }
+            jackknife_del1(avg_del1, avg, var);
+            jackknife_del1(sus_del1, sus, var_sus);
+        }
+
+        out_obs << g2p << " " << avg << " " << sqrt(var) << " " << sus << " " << sqrt(var_sus) << " " << rw_ess(total)/data.S2.n_elem << endl;
+    }
+
+    out_obs.close();
+
+    //********* END ANALYSIS **********//
+
+    return 0;
+}
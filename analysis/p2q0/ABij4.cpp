@@ -8,6 +8,7 @@
 #include "utils.hpp"
 #include "params.hpp"
 #include "statistics.hpp"
+#include "dataset.hpp"
 
 using namespace std;
 using namespace arma;
@@ -131,6 +132,13 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    // Burn-in cuts listed in path/burnin.txt and decimation view of
+    // path/decimation.txt, read once for all jobs
+    map<string, int> burnin;
+    Decimation dec;
+    if(!read_burnin(path, burnin) || !read_decimation(path, dec))
+        return 1;
+
     // Cycle on g2 values
     for(const auto& g2 : g2_vec)
     {
@@ -150,16 +158,24 @@ int main(int argc, char** argv)
             ifstream in_hl;
             in_hl.open(array_path + "/" + filename + "_HL.txt");
 
+            // Skip thermalization samples listed in path/burnin.txt and the
+            // ones before the decimation view
+            JobView view = job_view(burnin, dec, g2, job_vec[i], sm.samples);
+            skip_hl(in_hl, view.first, sm);
+
             // Create vector of correlated samples
-            vec vec_corr_A(sm.samples);
-            vec vec_corr_B(sm.samples);
+            vec vec_corr_A(view.size);
+            vec vec_corr_B(view.size);
 
             // Cycle on samples
-            for(int j=0; j<sm.samples; ++j) 
+            for(int j=0; j<view.size; ++j) 
             {
                 Geom24 G(sm.p, sm.q, sm.dim, g2);
                 G.read_mat(in_hl);
 
+                // Go to the next sample of the view
+                skip_stride_hl(in_hl, view, sm);
+
                 cx_mat W = G.get_mat(0) + cx_double(0.,1.)*G.get_mat(1);
                 cx_double trW = trace(W);
                 
@@ -8,6 +8,9 @@
 #include "utils.hpp"
 #include "params.hpp"
 #include "statistics.hpp"
+#include "dataset.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
 
 using namespace std;
 using namespace arma;
@@ -26,6 +29,9 @@ int main(int argc, char** argv)
     string prefix = "GEOM";
     string path = argv[1];
 
+    // Summation scheme of the observable sums (RFL_SUM environment variable)
+    int mode = sum_mode();
+
 
 
     //********* BEGIN PARAMETER INITIALIZATION **********//
@@ -126,6 +132,13 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    // Burn-in cuts listed in path/burnin.txt and decimation view of
+    // path/decimation.txt, read once for all jobs
+    map<string, int> burnin;
+    Decimation dec;
+    if(!read_burnin(path, burnin) || !read_decimation(path, dec))
+        return 1;
+
     // Cycle on g2 values
     for(const auto& g2 : g2_vec)
     {
@@ -135,8 +148,11 @@ int main(int argc, char** argv)
         // Create vector of uncorrelated samples
         vec samples(job_vec.size());
 
-        // Cycle on jobs in the array
-        for(unsigned i=0; i<job_vec.size(); ++i)
+        // Jobs are independent, each one is read and summed by a single
+        // thread in the same order as a serial run, so the result does not
+        // depend on the number of threads
+        vector<string> error(job_vec.size());
+        parallel_for(0, job_vec.size(), [&](int i, int)
         {
             // Open data files
             string array_path = path + "/" + cc_to_name(g2) + "/" + to_string(job_vec[i]);
@@ -145,17 +161,27 @@ int main(int argc, char** argv)
             in_s.open(array_path + "/" + filename + "_S.txt");
             in_hl.open(array_path + "/" + filename + "_HL.txt");
 
+            // Skip thermalization samples listed in path/burnin.txt and the
+            // ones before the decimation view
+            JobView view = job_view(burnin, dec, g2, job_vec[i], sm.samples);
+            skip_s(in_s, view.first);
+            skip_hl(in_hl, view.first, sm);
+
             // Create vector of correlated samples
-            vec vec_corr(sm.samples);
+            vec vec_corr(view.size);
 
             // Cycle on samples
-            for(int j=0; j<sm.samples; ++j) 
+            for(int j=0; j<view.size; ++j) 
             {
                 Geom24 G(sm.p, sm.q, sm.dim, g2);
                 double S2, S4;
                 in_s >> S2 >> S4;
                 G.read_mat(in_hl);
 
+                // Go to the next sample of the view
+                skip_stride_s(in_s, view);
+                skip_stride_hl(in_hl, view, sm);
+
                 cx_mat W = G.get_mat(0) + cx_double(0.,1.)*G.get_mat(1);
                 cx_double trW = trace(W);
                 
@@ -165,23 +191,23 @@ int main(int argc, char** argv)
 
                 if(abs(trace(V)) > 1e-8)
                 {
-                    cerr << "Error: V is not traceless." << endl;
-                    return 1;
+                    error[i] = "V is not traceless.";
+                    return;
                 }
                 if(!A.is_hermitian())
                 {
-                    cerr << "Error: A is not hermitian." << endl;
-                    return 1;
+                    error[i] = "A is not hermitian.";
+                    return;
                 }
                 if(!B.is_hermitian())
                 {
-                    cerr << "Error: B is not hermitian." << endl;
-                    return 1;
+                    error[i] = "B is not hermitian.";
+                    return;
                 }
 
 
                 // ***** COMPUTE OBSERVABLE HERE *****
-                double temp = 0;
+                SumAccumulator acc(mode);
                 int counter = 0;
                 for(int i=0; i<sm.dim; ++i)
                 {
@@ -197,7 +223,7 @@ int main(int argc, char** argv)
                                     {
                                         if( (l!=i) && (l!=j) && (l!=k) )
                                         {
-                                            temp += pow(abs(A(i,j)), 2)*pow(abs(A(k,l)), 2);
+                                            acc.add(pow(abs(A(i,j)), 2)*pow(abs(A(k,l)), 2));
                                             ++counter;
                                         }
                                     }
@@ -206,7 +232,7 @@ int main(int argc, char** argv)
                         }
                     }
                 }
-                temp /= counter;
+                double temp = acc.result()/counter;
                 // ***** THAT'S IT, YOU'RE DONE *****
 
                 vec_corr(j) = temp;
@@ -215,7 +241,16 @@ int main(int argc, char** argv)
             in_hl.close();
 
             // Initialize i-th element of vector of uncorrelated samples with mean of job #i
-            samples(i) = mean(vec_corr);
+            samples(i) = reduce_mean(vec_corr, mode);
+        });
+
+        for(unsigned i=0; i<job_vec.size(); ++i)
+        {
+            if(!error[i].empty())
+            {
+                cerr << "Error: " + error[i] << endl;
+                return 1;
+            }
         }
 
 
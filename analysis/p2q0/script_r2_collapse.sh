@@ -0,0 +1,3 @@
+#!/bin/bash
+
+../common/fss_collapse r2 $1 $2 ../../data/p2q0 ../../data/p2q0/datasetp2q0_8 ../../data/p2q0/datasetp2q0_10 ../../data/p2q0/datasetp2q0_12 ../../data/p2q0/datasetp2q0_14 ../../data/p2q0/datasetp2q0_16 ../../data/p2q0/datasetp2q0_18 ../../data/p2q0/datasetp2q0_22 ../../data/p2q0/datasetp2q0_32 ${@:3}
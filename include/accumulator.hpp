@@ -0,0 +1,50 @@
+#ifndef ACCUMULATOR_HPP
+#define ACCUMULATOR_HPP
+
+#include <armadillo>
+#include <string>
+#include <vector>
+
+// Power sums of a block of samples of an observable, enough to
+// recompute the mean, the susceptibility and the Binder cumulants
+struct Moments
+{
+    double n;
+    double s1;
+    double s2;
+    double s4;
+
+    Moments() : n(0), s1(0), s2(0), s4(0) {}
+
+    void add(double);
+    void merge(const Moments&);
+
+    // Same sums in the layout of reweight.hpp, with unit weights
+    arma::rowvec rw_row() const;
+};
+
+// Block sums of one job at one g2, block b holding samples
+// [b*block, (b+1)*block) counted after the burn-in cut
+struct JobAcc
+{
+    double g2;
+    int job;
+    std::vector<Moments> blocks;
+};
+
+// Content of an accumulator sidecar
+struct AccFile
+{
+    int block;
+    std::vector<JobAcc> jobs;
+};
+
+// Sidecar of an observable: path/observables/<name>_acc.txt
+std::string acc_filename(const std::string&, const std::string&);
+
+// Write and read a sidecar, one "g2 job first n s1 s2 s4" line per block
+// after a "block" header line; values are written with full precision
+bool write_acc(const std::string&, const AccFile&);
+bool read_acc(const std::string&, AccFile&);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef BINARY_HPP
+#define BINARY_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <armadillo>
+#include "dataset.hpp"
+#include "parse.hpp"
+#include "cache.hpp"
+#include "sample.hpp"
+
+// Matrix-major binary copy of the S and HL files of a job, in <name>.bin
+// next to them: the action components of all samples (burn-in included),
+// then matrix 0 of all samples, matrix 1 of all samples and so on, each
+// matrix column by column as armadillo stores it. Readers only touch the
+// sections they need. A copy is used as long as the text files it was
+// made from are unchanged (or have been removed).
+// Packed copies keep only the diagonal and the upper triangle of every
+// matrix, the rest following from H being Hermitian and L anti-Hermitian,
+// which halves the size of the matrix sections.
+// Single precision copies, in <name>_f.bin, hold the matrices as floats
+// (the action stays in double precision). Readers use them only when
+// asked to (see Projection)
+
+// File of the binary copy of a job, or of its single precision copy
+std::string binary_filename(const Dataset&, double, int, bool single=false);
+
+// Convert the text files of a job, packed if asked for. A job with
+// matrices that are not exactly (anti-)Hermitian is written in full,
+// and packed is set to false
+bool write_binary(const Dataset&, double, int, bool&, bool single=false);
+
+// Compare a binary copy with the text files, counting the values that
+// don't have the same bits (after rounding the text to single precision
+// for a single precision copy). False if either can't be read
+bool verify_binary(const Dataset&, double, int, long long&, bool single=false);
+
+// Packed H (L if the flag is true): the real (imaginary) part of the
+// diagonal, then the strict upper triangle column by column as (re, im)
+// pairs. False if unpacking would not give back the same bits
+bool pack_matrix(const arma::cx_mat&, bool, double*);
+void unpack_matrix(const double*, bool, arma::cx_mat&);
+
+// Next matrix of an HL file, rows of the text becoming columns
+bool read_text_matrix(TextReader&, arma::cx_mat&);
+
+// Whether the text files of a job are still those with the given stamps
+// (S, then HL). Files that are gone count as unchanged
+bool text_unchanged(const Dataset&, double, int, const FileStamp&, const FileStamp&);
+
+// Compare the first n samples handed out by a reader with the text files,
+// counting the values that don't have the same bits, with the matrices of
+// the text rounded to single precision if asked for
+bool compare_with_text(const Dataset&, double, int, long long, const std::function<bool(Sample&)>&, long long&, bool single=false);
+
+// Sequential reader of the sections of a binary copy that a projection needs
+class BinaryReader
+{
+    private:
+        std::vector<std::unique_ptr<std::ifstream>> in;
+        std::vector<int> part;
+        std::vector<long long> base;
+        std::vector<double> buf;
+        std::vector<float> fbuf;
+        long long n;
+        long long n_val;
+        long long stride;
+        int dim;
+        int n_h;
+        bool packed;
+        bool single;
+
+    public:
+        BinaryReader() : n(0), n_val(0), stride(0), dim(0), n_h(0), packed(false), single(false) {}
+
+        // False if there is no up to date copy (of the given precision)
+        bool open(const Dataset&, double, int, const Projection&, bool single=false);
+
+        // Samples in the file, burn-in included
+        long long size() const { return n; }
+
+        bool is_packed() const { return packed; }
+        bool is_single() const { return single; }
+
+        // Move to sample j of the file
+        bool seek(long long);
+
+        bool read(Sample&);
+};
+
+#endif
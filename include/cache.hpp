@@ -0,0 +1,68 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "dataset.hpp"
+
+// Size, modification time (ns) and content hash of a data file
+struct FileStamp
+{
+    long long size;
+    long long mtime;
+    unsigned long long hash;
+
+    FileStamp() : size(-1), mtime(0), hash(0) {}
+};
+
+// Size and modification time of a file (cheap, no reading). Like the hash
+// below, it is taken on the compressed version if only that exists, and
+// is the one recorded when packing if the file was compacted
+bool file_stamp(const std::string&, FileStamp&);
+
+// 64-bit FNV-1a hash of the content of a file
+bool file_hash(const std::string&, unsigned long long&);
+
+// Whether a file still has the size and mtime of a stamp, or at least
+// the same content if only the mtime changed
+bool file_matches(const std::string&, const FileStamp&);
+
+// Create path/cache if needed
+bool make_cache_dir(const Dataset&);
+
+// Create the folder of a job if needed (it is gone once the coupling is
+// compacted and the originals removed, but indices and copies go there)
+bool make_job_dir(const Dataset&, double, int);
+
+// Cached partial results of one job at one g2, stored in path/cache with
+// one entry per name (e.g. an observable). An entry is valid as long as its
+// tag (version and parameters of what was computed), the view of the job
+// (burn-in cut and decimation) and the data files it was computed from are
+// unchanged. Files whose size and
+// mtime both match are trusted; if only the mtime changed, the content hash
+// decides
+class JobCache
+{
+    private:
+        std::string stem;
+        JobView view;
+        std::vector<std::string> files;
+        std::vector<FileStamp> stamps;
+        bool hashed;
+
+        bool hash_files();
+
+    public:
+        // Data files are the S file and, if read_hl is true, the HL file
+        JobCache(const Dataset&, double, int, bool read_hl=true);
+
+        // Open an entry for reading, positioned after its header;
+        // false if missing or stale
+        bool open(const std::string&, const std::string&, std::ifstream&);
+
+        // Create (or replace) an entry and write its header
+        bool create(const std::string&, const std::string&, std::ofstream&);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef COMPACT_HPP
+#define COMPACT_HPP
+
+#include <string>
+#include "dataset.hpp"
+#include "cache.hpp"
+#include "sample.hpp"
+
+// Compacted couplings: the S and HL text of all the jobs at one coupling
+// packed into a few large shards, path/<g2>/jobs_<gen>_<k>.bin, with an index
+// path/<g2>/jobs_idx.bin holding for every file its job, its name, its
+// place in the shards, the stamp of the original file and the offsets of
+// its samples. A job file that is missing is looked up there, so readers,
+// stamps and indices see a compacted coupling as the directory layout
+
+// Place of a compacted job file
+struct CompactEntry
+{
+    std::string shard;
+    long long offset;
+    long long size;
+    FileStamp stamp;
+};
+
+// Entry of the job file with this path, false if it isn't compacted
+bool find_compacted(const std::string&, CompactEntry&);
+
+// Offsets of the samples of a compacted job, as in its persistent index
+// (HL offsets only if read_hl is true)
+bool compacted_index(const Dataset&, double, int, bool, SampleIndex&);
+
+// Pack the files of all the jobs of a coupling into shards of about the
+// given number of bytes (a job is never split), reading them through the
+// old shards if the coupling was compacted already
+bool compact_coupling(const Dataset&, double, long long);
+
+// Read the shards of a coupling back, counting the files whose content
+// doesn't hash to what was packed
+bool verify_compacted(const Dataset&, double, long long&);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef COMPRESS_HPP
+#define COMPRESS_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "dataset.hpp"
+#include "sample.hpp"
+
+// Compressed copy of the S and HL files of a job, in <name>_z.bin next to
+// them. The samples (burn-in included) are cut in chunks of a fixed number
+// of them, and every part of a chunk (the action, then each matrix, packed
+// as in the binary copy when exact) is a stream that can be decoded on its
+// own. Each value is XOR-ed with the same value of the previous sample and
+// only the bits between the leading and trailing zeros of the result are
+// kept, so slowly moving Markov chains take little space. The offsets of
+// the streams are at the end of the file. Decoding is lossless and, like
+// the binary copy, the copy is used while the text files are unchanged
+
+// File of the compressed copy of a job
+std::string compressed_filename(const Dataset&, double, int);
+
+// Compress the text files of a job in chunks of the given number of
+// samples, packed if asked for (packed is set to false if the matrices are
+// not exactly (anti-)Hermitian). Bytes per sample of the copy go in ratio
+// as a fraction of the full binary size
+bool write_compressed(const Dataset&, double, int, int, bool&, double&);
+
+// Compare a compressed copy with the text files, counting the values that
+// don't have the same bits
+bool verify_compressed(const Dataset&, double, int, long long&);
+
+// Sequential reader of the streams of a compressed copy that a projection
+// needs. Chunks are decoded a few at a time on n_thr threads
+class CompressedReader
+{
+    private:
+        std::ifstream in;
+        std::vector<int> part;
+        std::vector<int> n_val;
+        std::vector<int64_t> off;
+        std::vector<std::vector<double>> dec;
+        std::vector<std::vector<uint64_t>> words;
+        long long n;
+        int chunk;
+        int n_parts;
+        int dim;
+        int n_h;
+        bool packed;
+        int n_thr;
+        long long first;
+        long long n_dec;
+        long long pos;
+
+        bool decode(long long);
+
+    public:
+        CompressedReader() : n(0), chunk(1), n_parts(0), dim(0), n_h(0), packed(false), n_thr(1), first(0), n_dec(0), pos(0) {}
+
+        // False if there is no up to date copy
+        bool open(const Dataset&, double, int, const Projection&);
+
+        // Samples in the file, burn-in included
+        long long size() const { return n; }
+
+        bool is_packed() const { return packed; }
+
+        // Threads decoding chunks
+        void set_threads(int n_thr_) { n_thr = std::max(1, n_thr_); }
+
+        // Move to sample j of the file
+        bool seek(long long);
+
+        bool read(Sample&);
+};
+
+#endif
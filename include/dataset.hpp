@@ -0,0 +1,97 @@
+#ifndef DATASET_HPP
+#define DATASET_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+#include "params.hpp"
+
+// Decimation view of the jobs, from path/decimation.txt (lines "key value"
+// with keys cut, offset, stride and max). Samples before the cut, or before
+// the burn-in cut of the job if that is later, and then offset more are
+// skipped, after that one every stride is kept, at most max of them (0 for
+// all). The data files are never touched, readers apply the view
+struct Decimation
+{
+    int cut;
+    int offset;
+    int stride;
+    int max;
+
+    Decimation() : cut(0), offset(0), stride(1), max(0) {}
+};
+
+// Samples of a job in its view: sample k is sample first + k*stride of
+// the files
+struct JobView
+{
+    int first;
+    int stride;
+    int size;
+};
+
+// Everything a driver needs to know about a dataset folder
+struct Dataset
+{
+    std::string path;
+    std::string prefix;
+    struct Simul_params sm;
+
+    // Number of H and L matrices in each sample
+    int nH;
+    int nL;
+
+    // Content of g2_val.txt and job_idx.txt
+    std::vector<double> g2_vec;
+    std::vector<int> job_vec;
+
+    // Burn-in cuts from burnin.txt, keyed by burnin_key
+    std::map<std::string, int> burnin;
+
+    // Decimation view from decimation.txt
+    Decimation dec;
+};
+
+// Read init.txt, g2_val.txt and job_idx.txt from the dataset folder
+bool read_dataset(const std::string&, Dataset&);
+
+// Read the burn-in index path/burnin.txt (lines "g2 job cut"), a missing file means no cut
+bool read_burnin(const std::string&, std::map<std::string, int>&);
+
+// Key of a (g2, job) pair in the burn-in index
+std::string burnin_key(double, int);
+
+// Number of leading samples of a job at coupling g2 to discard as burn-in
+int burnin_cut(const Dataset&, double, int);
+
+// Read the decimation view path/decimation.txt, a missing file means no decimation
+bool read_decimation(const std::string&, Decimation&);
+
+// Write it, or remove the file if the view keeps every sample
+bool write_decimation(const std::string&, const Decimation&);
+
+// View of a job at coupling g2: burn-in cut and decimation. At least one
+// sample is kept, the last one if the cuts leave none (read_dataset warns)
+JobView job_view(const Dataset&, double, int);
+
+// Same from cuts and a view read by read_burnin and read_decimation, for the
+// drivers that read the files themselves, warning if only the last of the
+// n samples of the job is kept
+JobView job_view(const std::map<std::string, int>&, const Decimation&, double, int, int);
+
+// Skip samples of an _S.txt or _HL.txt stream without parsing them
+// (does nothing if the stream is not open)
+void skip_s(std::istream&, int);
+void skip_hl(std::istream&, int, const struct Simul_params&);
+
+// Move a stream left right after a parsed sample to the next sample of the
+// view, skipping stride-1 samples (does nothing for stride 1 or if the stream
+// is not open)
+void skip_stride_s(std::istream&, const JobView&);
+void skip_stride_hl(std::istream&, const JobView&, const struct Simul_params&);
+
+// Path of the data files of a job at coupling g2, without the _S.txt/_HL.txt suffix
+std::string data_path(const Dataset&, double, int);
+
+#endif
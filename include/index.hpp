@@ -0,0 +1,30 @@
+#ifndef INDEX_HPP
+#define INDEX_HPP
+
+#include <string>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "cache.hpp"
+
+// Persistent index of the byte offsets of every sample in the S and HL
+// files of a job (burn-in included), kept next to them in <name>_idx.bin
+// together with the sample counts and the size, mtime and hash of both
+// files. An index is used only while the files match it: size and mtime,
+// or the content hash if only the mtime changed
+
+// File of the index of a job
+std::string index_filename(const Dataset&, double, int);
+
+// Scan the files of a job for the offsets of all their samples, and
+// stamp them (the HL stamp keeps size -1 if there is no HL file)
+bool scan_index(const Dataset&, double, int, SampleIndex&, FileStamp&, FileStamp&);
+
+// Scan the files of a job and write their index
+bool write_index(const Dataset&, double, int);
+
+// Read the index of a job, false if missing or out of date (HL offsets
+// are only required if read_hl is true). Without an index file, the
+// offsets recorded when the coupling was compacted are used
+bool read_index(const Dataset&, double, int, bool, SampleIndex&);
+
+#endif
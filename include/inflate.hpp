@@ -0,0 +1,44 @@
+#ifndef INFLATE_HPP
+#define INFLATE_HPP
+
+#include <string>
+#include <memory>
+
+// Name of the file holding a text file: the file itself, or else its gzip
+// (.gz) or xz (.xz) compressed version. The name itself if none exists
+std::string stored_file(const std::string&);
+
+// Bytes of a text file, decompressed on the fly if it is stored compressed.
+// bgzip files (gzip members of at most 64 kB with their size in the header)
+// are indexed when opened, so that seeks are cheap and batches of members
+// are decompressed in parallel. Other gzip and xz files are decompressed
+// by a thread of their own a few blocks ahead of the reader, and seeking
+// back means starting over
+class ByteSource
+{
+    public:
+        virtual ~ByteSource() {}
+
+        // Up to n bytes, fewer only at the end of the text. Returns the
+        // number of bytes read, -1 on error
+        virtual long long read(char*, long long) = 0;
+
+        // Move to an offset of the uncompressed text
+        virtual bool seek(long long) = 0;
+
+        // Uncompressed size, -1 if unknown without decompressing
+        virtual long long size() const = 0;
+
+        // Whether seeks cost no more than the bytes read after them
+        virtual bool random_access() const { return true; }
+
+        // Threads decompressing independent blocks, if the format has them
+        virtual void set_threads(int) {}
+};
+
+// Open a text file, or its compressed version (see stored_file), or its
+// region of a shard if it was compacted (see compact.hpp).
+// nullptr if there is none of them or it can't be read
+std::unique_ptr<ByteSource> open_source(const std::string&);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef OBSERVABLES_HPP
+#define OBSERVABLES_HPP
+
+#include <string>
+#include <vector>
+#include "sample.hpp"
+
+// Observable computed on a single sample at coupling g2
+typedef double (*obs_fn)(const Sample&, double);
+
+// Parts of a sample an observable reads
+enum
+{
+    USE_ACTION = 1,
+    USE_H = 2,
+    USE_L = 4
+};
+
+struct Observable
+{
+    std::string name;
+    obs_fn f;
+
+    // Whether the matrices have to be read. Observables that need them
+    // must not depend on g2, only the action components may
+    bool need_hl;
+
+    // Bump whenever the definition changes, so that cached results are recomputed
+    int version;
+
+    // Combination of the USE_ flags, readers decode nothing else
+    int uses;
+};
+
+// List of registered observables
+const std::vector<Observable>& observables();
+
+// Look up a registered observable by name, nullptr if not found
+const Observable* find_observable(const std::string&);
+
+// Parts of a sample needed by a set of observables
+Projection projection(const Dataset&, const std::vector<const Observable*>&);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <functional>
+
+// Number of worker threads (RFL_THREADS environment variable, or all cores)
+int n_threads();
+
+// Run f(i, t) for every i in [begin, end), t being the index of the thread
+// that executes iteration i (useful to address per-thread buffers)
+void parallel_for(int, int, const std::function<void(int, int)>&, int n_thr=n_threads());
+
+#endif
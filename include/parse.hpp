@@ -0,0 +1,53 @@
+#ifndef PARSE_HPP
+#define PARSE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "inflate.hpp"
+
+// Parse a double starting at p (no leading whitespace) and move p past it.
+// The text must be followed by a character that can't continue a number.
+// The result is correctly rounded, the same as strtod in the C locale
+bool parse_double(const char*&, double&);
+
+// Reader of whitespace separated numbers from a text file, with large
+// block reads and no stream formatting or locale in the way. A file
+// stored compressed is decompressed on the fly (see ByteSource)
+class TextReader
+{
+    private:
+        std::unique_ptr<ByteSource> in;
+        std::vector<char> buf;
+        std::size_t buf_size;
+        std::size_t pos;
+        std::size_t end;
+        long long offset;
+        bool at_eof;
+
+        void refill();
+
+    public:
+        TextReader(std::size_t buf_size=1 << 20);
+
+        bool open(const std::string&);
+        bool is_open() const { return (bool)in; }
+
+        // Whether seeks are cheap, false for compressed files without blocks
+        bool random_access() const { return !in || in->random_access(); }
+
+        // Threads decompressing a file stored in independent blocks
+        void set_threads(int n_thr) { if(in) in->set_threads(n_thr); }
+
+        // Read the next number, false at the end of the file or on bad input
+        bool read(double&);
+
+        // Skip n lines, the last one may end the file without a newline
+        bool skip_lines(long long);
+
+        // Byte offset of the next character in the file, and move there
+        long long tell() const { return offset + pos; }
+        bool seek(long long);
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef REDUCE_HPP
+#define REDUCE_HPP
+
+#include <armadillo>
+#include <vector>
+
+// Summation schemes: plain running sum, pairwise over a fixed binary
+// tree, or compensated (Neumaier). The last two make sums independent
+// of how the terms were split among threads
+enum {SUM_PLAIN, SUM_PAIRWISE, SUM_NEUMAIER};
+
+// Scheme set by the RFL_SUM environment variable (plain, pairwise or neumaier),
+// so that every driver can be switched without recompiling. If unset, plain,
+// or neumaier when single precision copies are read (RFL_PRECISION=single)
+int sum_mode();
+
+// Streaming sum of terms added one at a time with the given scheme
+class SumAccumulator
+{
+    private:
+        int mode;
+        double s;
+        long n;
+        std::vector<double> lane_s;
+        std::vector<double> lane_c;
+        std::vector<double> leaf;
+        std::vector<double> partial;
+
+    public:
+        SumAccumulator(int mode=sum_mode());
+
+        void add(double);
+        double result() const;
+};
+
+// Sum of n values, pairwise over a fixed tree with leaves of 8 terms
+double pairwise_sum(const double*, int);
+
+// Sum of n values with 4 independent compensated lanes (vectorizable)
+double neumaier_sum(const double*, int);
+
+// Sum and mean of a vector with the given scheme
+// (plain gives the same result as arma::accu and arma::mean)
+double reduce_sum(const arma::vec&, int mode=sum_mode());
+double reduce_mean(const arma::vec&, int mode=sum_mode());
+
+#endif
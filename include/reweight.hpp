@@ -0,0 +1,67 @@
+#ifndef REWEIGHT_HPP
+#define REWEIGHT_HPP
+
+#include <armadillo>
+#include <vector>
+#include "dataset.hpp"
+#include "observables.hpp"
+
+// Per-sample quantities of one job needed to reweight an observable
+struct RwJob
+{
+    arma::vec S2;
+    arma::vec S4;
+    arma::vec obs;
+};
+
+// Components of the per-job sums produced by reweight_sums
+enum {RW_W, RW_WO, RW_WO2, RW_WO4, RW_W2, RW_NCOMP};
+
+// Overflow-safe log(sum(exp(x)))
+double log_sum_exp(const arma::vec&);
+
+// Read every job at coupling g2 (in parallel) and evaluate the observable on each sample
+bool load_rw_jobs(const Dataset&, double, const Observable&, std::vector<RwJob>&);
+
+// Per-job sums at coupling g2p of samples simulated at g2, one row per job:
+// [sum w, sum w*O, sum w*O^2, sum w*O^4, sum w^2] with w = exp(-(g2p-g2)*S2),
+// all weights being rescaled by the same factor to avoid overflow
+void reweight_sums(const std::vector<RwJob>&, double, double, const Observable&, arma::mat&);
+
+// Estimators built from the (summed) components
+double rw_mean(const arma::rowvec&);
+double rw_sus(const arma::rowvec&);
+double rw_ess(const arma::rowvec&);
+
+// Binder cumulant 1 - <m^4>/(3<m^2>^2), the observable being m or m^2 respectively
+double rw_binder(const arma::rowvec&);
+double rw_binder_sq(const arma::rowvec&);
+
+
+// Samples of every g2 point of a dataset, kept in memory for the multi-histogram method
+struct WhamData
+{
+    std::vector<double> g2;
+    int n_jobs;
+
+    // One entry per sample: action components, observable, g2 index and job position
+    arma::vec S2;
+    arma::vec S4;
+    arma::vec obs;
+    arma::uvec run;
+    arma::uvec job;
+};
+
+// Read every g2 point and job of the dataset, evaluating the observable on each sample
+bool load_wham_data(const Dataset&, const Observable&, WhamData&);
+
+// Solve the multi-histogram (Ferrenberg-Swendsen) equations for the free
+// energies f of each g2 point (with f(0) = 0), leaving out job 'skip' if >= 0.
+// f is used as starting point if it has the right size; returns the number
+// of iterations, or -1 if the tolerance was not reached
+int wham_solve(const WhamData&, arma::vec&, int skip=-1, double tol=1e-10, int max_iter=10000);
+
+// Per-job sums at coupling g2p from the multi-histogram weights, same layout as reweight_sums
+void wham_sums(const WhamData&, const arma::vec&, double, const Observable&, arma::mat&, int skip=-1);
+
+#endif
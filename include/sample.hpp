@@ -0,0 +1,162 @@
+#ifndef SAMPLE_HPP
+#define SAMPLE_HPP
+
+#include <armadillo>
+#include <fstream>
+#include <vector>
+#include <memory>
+#include "dataset.hpp"
+#include "parse.hpp"
+
+// Content of one sample: action components and Dirac matrices
+// (the nH H matrices come first, then the nL L matrices)
+struct Sample
+{
+    double S2;
+    double S4;
+    int dim;
+    int nH;
+    int nL;
+    std::vector<arma::cx_mat> mat;
+
+    Sample() : S2(0), S4(0), dim(0), nH(0), nL(0) {}
+    Sample(const Dataset&);
+};
+
+// Whether readers should use the single precision copies of the jobs
+// (RFL_PRECISION environment variable set to single)
+bool single_precision();
+
+// Parts of a sample that a reader decodes: the action components and
+// the matrices whose indices are listed. Parts left out keep whatever
+// values the sample had. With single set, the single precision binary
+// copy of a job is used when there is one
+struct Projection
+{
+    bool action;
+    std::vector<int> mats;
+    bool single;
+
+    Projection() : action(true), single(single_precision()) {}
+};
+
+// All the matrices (or none) and the action
+Projection full_projection(const Dataset&, bool read_hl=true);
+
+class BinaryReader;
+class CompressedReader;
+
+// Offsets of the samples of one job in its S and HL files
+struct SampleIndex
+{
+    std::vector<std::streamoff> s;
+    std::vector<std::streamoff> hl;
+};
+
+// Sequential reader of the samples in the view of one job at one coupling
+// g2 (see job_view), from the matrix-major binary copy of the job if there
+// is one (the single precision one first, if the projection allows it),
+// then from its compressed copy, otherwise from the text files. Samples
+// left out by the view are seeked over, or skipped without parsing
+class SampleReader
+{
+    private:
+        TextReader in_s;
+        TextReader in_hl;
+        Projection proj;
+        std::vector<char> want;
+        bool read_hl;
+        bool mid_line;
+        int n_samples;
+        int n_read;
+        int n_mat;
+        int first;
+        int stride;
+        SampleIndex known;
+        bool indexed;
+        std::unique_ptr<BinaryReader> bin;
+        std::unique_ptr<CompressedReader> zip;
+
+        void open_text(const Dataset&, double, int);
+
+    public:
+        // Open the files of a job, decoding only the parts of the samples in
+        // the projection. The persistent index of the job is used if up to date
+        SampleReader(const Dataset&, double, int, const Projection&);
+
+        // HL is not touched if read_hl is false
+        SampleReader(const Dataset&, double, int, bool read_hl=true);
+
+        // Open the text files at the first sample of an index of the view,
+        // without any scan
+        SampleReader(const Dataset&, double, int, const SampleIndex&, const Projection&);
+
+        ~SampleReader();
+
+        bool is_open() const;
+        int size() const { return n_samples; }
+
+        // Whether the samples come from a binary or compressed copy (nothing to parse)
+        bool binary() const { return bin || zip; }
+
+        // Threads decoding a compressed copy, or decompressing text files
+        // stored in independent blocks
+        void set_threads(int);
+
+        // Whether seeks are cheap (false for text files that are compressed
+        // as a single stream)
+        bool random_access() const;
+
+        // Read the next sample, returns false at the end of the job or on error
+        bool read(Sample&);
+
+        // Offset of every sample, from the persistent index or from a scan
+        // of the files (no parsing), then go back to the first sample.
+        // With a binary or compressed copy the index holds the sample numbers
+        bool build_index(SampleIndex&);
+
+        // Move to sample j using an index built before
+        bool seek(const SampleIndex&, int);
+};
+
+// Reader of the samples of one job that parses chunks of the files on
+// several threads and hands the samples out in order. The chunks are cut
+// at sample boundaries found by a newline scan. With one thread, a binary
+// copy to read from or text files without random access, it is a plain
+// SampleReader (which decodes a compressed copy on the threads itself)
+class ChunkedReader
+{
+    private:
+        const Dataset& ds;
+        double g2;
+        int job;
+        Projection proj;
+        int n_thr;
+        SampleReader reader;
+        SampleIndex idx;
+        int chunk;
+        int n_read;
+        int first;
+        int n_buf;
+        std::vector<Sample> buf;
+        std::vector<std::unique_ptr<SampleReader>> helpers;
+        bool ok;
+
+        bool fill();
+
+    public:
+        ChunkedReader(const Dataset&, double, int, const Projection&, int n_thr=1);
+        ChunkedReader(const Dataset&, double, int, bool read_hl=true, int n_thr=1);
+
+        bool is_open() const { return ok && reader.is_open(); }
+        int size() const { return reader.size(); }
+
+        // Read the next sample, returns false at the end of the job or on error
+        bool read(Sample&);
+};
+
+// Permutation of 0..n-1 in bit-reversed order: every prefix is spread
+// almost evenly over the whole range
+std::vector<int> bit_reversed_order(int);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SCALING_HPP
+#define SCALING_HPP
+
+#include <armadillo>
+#include <vector>
+#include "dataset.hpp"
+#include "observables.hpp"
+
+// Reweighted curve of an observable of one dataset on a dense g2 grid.
+// Per-job sums are kept, so that delete-1 curves come at no extra cost
+struct RwCurve
+{
+    int dim;
+    int n_jobs;
+    arma::vec g2;
+
+    // Whether the grid point is a simulated g2 value
+    std::vector<bool> simulated;
+
+    // Per-job reweighting sums of each grid point (layout of reweight_sums)
+    std::vector<arma::mat> sums;
+};
+
+// Build the curve with n_pts reweighted points between neighbouring g2 values,
+// grid points whose effective sample size fraction is below ess_min are dropped
+bool build_rw_curve(const Dataset&, const Observable&, int, double, RwCurve&);
+
+// Evaluate an estimator of the reweighting sums along the curve,
+// leaving out job 'skip' if >= 0 (only simulated points if sim_only)
+void curve_values(const RwCurve&, double f(const arma::rowvec&), arma::vec&, arma::vec&, int skip=-1, bool sim_only=false);
+
+// Position and height of the maximum of a sampled curve, refined with a parabola
+bool find_peak(const arma::vec&, const arma::vec&, double&, double&);
+
+// Position and height of the maximum from a quadratic fit to the
+// 2*half_width+1 points around the largest one. False if there are fewer
+// than 3 points or the fit has no maximum, the largest point (NaN if
+// there is none) is given instead
+bool fit_peak(const arma::vec&, const arma::vec&, int, double&, double&);
+
+// Crossing of two sampled curves closest to x_hint, by linear interpolation
+bool find_crossing(const arma::vec&, const arma::vec&, const arma::vec&, const arma::vec&, double, double&, double&);
+
+
+// Mean of an observable over the samples of each job at each g2 (one row per g2)
+bool load_job_means(const Dataset&, const Observable&, arma::mat&);
+
+// Points of one dataset entering a finite-size-scaling collapse
+struct CollapseSet
+{
+    int dim;
+    arma::vec g2;
+    arma::vec y;
+    arma::vec err;
+};
+
+// Scaling form y = dim^a f((g2 - g2c)*dim^b)
+struct CollapseParams
+{
+    double a;
+    double b;
+    double g2c;
+};
+
+// Scaled coordinates of a set for the given parameters
+void collapse_scale(const CollapseSet&, const CollapseParams&, arma::vec&, arma::vec&, arma::vec&);
+
+// Quality of the collapse: mean squared deviation, in units of the errors, of
+// every point from the linear interpolation of each other set at the same x
+double collapse_quality(const std::vector<CollapseSet>&, const CollapseParams&);
+
+// Minimize the quality over the box [lo, hi] by a parallel grid search that
+// zooms around the best point (parameters with lo == hi are kept fixed)
+double collapse_search(const std::vector<CollapseSet>&, const CollapseParams&, const CollapseParams&, CollapseParams&);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SKETCH_HPP
+#define SKETCH_HPP
+
+#include <vector>
+#include <ostream>
+#include <istream>
+
+// Mergeable streaming quantile estimator (KLL sketch). Level h holds
+// items of weight 2^h; a full level is sorted and every other item is
+// promoted to the next one. The choice of odd or even items comes from
+// the counter-based generator, so results only depend on the order of
+// insertions and merges
+class QuantileSketch
+{
+    private:
+        int k;
+        unsigned long n;
+        unsigned long n_compact;
+        std::vector<std::vector<double>> levels;
+
+        int capacity(int) const;
+        void compress();
+
+    public:
+        QuantileSketch(int k=200);
+
+        void insert(double);
+        void merge(const QuantileSketch&);
+
+        unsigned long size() const { return n; }
+
+        // Approximate q-quantile (rank error ~ 1/k)
+        double quantile(double) const;
+
+        // Exact text round trip of the whole state
+        void write(std::ostream&) const;
+        bool read(std::istream&);
+};
+
+// Mergeable fixed-bin histogram with automatic range. Bin width is a power
+// of two and bin edges are multiples of it, so widening the range (merging
+// pairs of bins) and merging histograms are exact
+class Histogram
+{
+    private:
+        int n_bins;
+        int e;
+        long long i_lo;
+        long long i_first, i_last;
+        unsigned long n;
+        std::vector<double> count;
+
+        void coarsen();
+        void add(long long, int, double);
+
+    public:
+        Histogram(int n_bins=100);
+
+        // Non-finite values are not binned, false is returned
+        bool insert(double, double weight=1.);
+        void merge(const Histogram&);
+
+        unsigned long size() const { return n; }
+        double width() const;
+
+        // Occupied bins as "center density" lines
+        void print(std::ostream&) const;
+
+        // Same, each line prefixed with the given value (e.g. g2)
+        void print(std::ostream&, double) const;
+
+        // Exact text round trip of the whole state
+        void write(std::ostream&) const;
+        bool read(std::istream&);
+};
+
+// Two-dimensional version of the histogram above, for joint distributions
+// of pairs of observables. Each axis widens independently; the occupied
+// rectangle is tracked so that insertions don't need to scan the bins
+class Histogram2D
+{
+    private:
+        int n_bins;
+        int ex, ey;
+        long long ix_lo, iy_lo;
+        long long ix_first, ix_last, iy_first, iy_last;
+        unsigned long n;
+        std::vector<double> count;
+
+        void coarsen(int);
+        void add(long long, long long, int, int, double);
+
+    public:
+        Histogram2D(int n_bins=50);
+
+        // Points with a non-finite coordinate are not binned, false is returned
+        bool insert(double, double, double weight=1.);
+        void merge(const Histogram2D&);
+
+        unsigned long size() const { return n; }
+        double width_x() const;
+        double width_y() const;
+
+        // Counts of this histogram on the bins of another one it was merged into
+        std::vector<double> counts_on(const Histogram2D&) const;
+
+        // Bins of the occupied rectangle as "prefix x y density error" lines,
+        // a blank line after each x. Errors are jackknife over the parts the
+        // histogram was merged from (e.g. one per job)
+        void print(std::ostream&, double, const std::vector<Histogram2D>&) const;
+
+        // Exact text round trip of the whole state
+        void write(std::ostream&) const;
+        bool read(std::istream&);
+};
+
+#endif
@@ -6,6 +6,41 @@
 // Jack knife mean and variance estimate of an arbitrary function f
 void jackknife(const arma::vec&, double&, double&, double f(const arma::vec&));
 
+// Jack knife mean and variance from already computed delete-1 estimates
+void jackknife_del1(const arma::vec&, double&, double&);
+
+// Jack knife mean and variance estimate of a function f of sums accumulated
+// per job (one row per job): the i-th cluster is the total minus row i
+void jackknife_sums(const arma::mat&, double&, double&, double f(const arma::rowvec&));
+
+// Burn-in cut of a correlated series by the MSER rule on batch means of the
+// given size: the cut minimizing the squared standard error of the remaining
+// batches, searched over the first half of the series
+int mser_cut(const arma::vec&, int batch=5);
+
+// Geweke diagnostic: z-score of the difference between the means of the first
+// and last fractions of a series, with standard errors from batch means
+double geweke_z(const arma::vec&, double first=0.1, double last=0.5);
+
+// Standard error of the mean of a correlated series from 10 batch means
+double batch_err(const arma::vec&);
+
+// Counter-based uniform random number in [0,1) from (seed, stream, counter).
+// The same triplet always gives the same number, whatever thread asks for it
+double counter_uniform(unsigned long, unsigned long, unsigned long);
+
+// Bootstrap mean and variance estimate of an arbitrary function f.
+// Replicas are computed in parallel, replica r drawing from stream r.
+// False (and nothing computed) with fewer than 2 replicas or no data
+bool bootstrap(const arma::vec&, double&, double&, double f(const arma::vec&), int n_rep=1000, unsigned long seed=0);
+
+// Same as above, also giving the percentile interval [lo, hi] at confidence level cl
+bool bootstrap(const arma::vec&, double&, double&, double&, double&, double f(const arma::vec&), double cl=0.6827, int n_rep=1000, unsigned long seed=0);
+
+// Moving block bootstrap of an arbitrary function f over correlated samples
+// (e.g. the samples of a single job), the second argument is the block length
+bool block_bootstrap(const arma::vec&, int, double&, double&, double&, double&, double f(const arma::vec&), double cl=0.6827, int n_rep=1000, unsigned long seed=0);
+
 // Some stat functions
 double my_mean(const arma::vec&);
 double my_var(const arma::vec&);
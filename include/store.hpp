@@ -0,0 +1,68 @@
+#ifndef STORE_HPP
+#define STORE_HPP
+
+#include <armadillo>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "dataset.hpp"
+#include "observables.hpp"
+
+// Columnar store of per-sample values: one binary file per (g2, job,
+// observable) in path/store, holding the values of the samples in the
+// view of the job. A column is out of date, and reads
+// fail, if the observable version, the view (burn-in cut and decimation),
+// or the size or mtime of the data files differ from when it was written
+
+// Sums of a series over blocks of 2^k samples, k >= 1, plus the sum and
+// the sum of squares of the samples. It is updated one sample at a time,
+// so it can be kept along with a series that grows
+class BlockPyramid
+{
+    private:
+        long long n;
+        double pending;
+        double sum1;
+        double sum2;
+        std::vector<std::vector<double>> levels;
+
+    public:
+        BlockPyramid() : n(0), pending(0), sum1(0), sum2(0) {}
+
+        void append(double);
+
+        long long size() const { return n; }
+
+        // Largest k with at least one complete block of 2^k samples
+        int depth() const { return levels.size(); }
+
+        // Means of the complete blocks of 2^k samples, k >= 1
+        arma::vec block_means(int) const;
+
+        // Sum and sum of squares of the samples
+        double sum() const { return sum1; }
+        double sum_sq() const { return sum2; }
+
+        void write(std::ostream&) const;
+        bool read(std::istream&);
+};
+
+// File of a column: path/store/<g2>_<job>_<name>.bin
+std::string column_filename(const Dataset&, double, int, const std::string&);
+
+// Create path/store if needed
+bool make_store_dir(const Dataset&);
+
+// Write the values of an observable for one job, followed by their block pyramid
+bool write_column(const Dataset&, double, int, const Observable&, const arma::vec&);
+
+// Read them back, false if missing or out of date
+bool read_column(const Dataset&, double, int, const Observable&, arma::vec&);
+
+// Same check without reading the values
+bool column_valid(const Dataset&, double, int, const Observable&);
+
+// Read only the block pyramid of a column, false if missing or out of date
+bool read_pyramid(const Dataset&, double, int, const Observable&, BlockPyramid&);
+
+#endif
@@ -0,0 +1,117 @@
+#include <armadillo>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "reweight.hpp"
+#include "accumulator.hpp"
+
+using namespace std;
+using namespace arma;
+
+
+void Moments::add(double x)
+{
+    double x2 = x*x;
+    n += 1;
+    s1 += x;
+    s2 += x2;
+    s4 += x2*x2;
+}
+
+void Moments::merge(const Moments& other)
+{
+    n += other.n;
+    s1 += other.s1;
+    s2 += other.s2;
+    s4 += other.s4;
+}
+
+rowvec Moments::rw_row() const
+{
+    rowvec row(RW_NCOMP);
+    row(RW_W) = n;
+    row(RW_WO) = s1;
+    row(RW_WO2) = s2;
+    row(RW_WO4) = s4;
+    row(RW_W2) = n;
+    return row;
+}
+
+string acc_filename(const string& path, const string& name)
+{
+    return path + "/observables/" + name + "_acc.txt";
+}
+
+bool write_acc(const string& filename, const AccFile& acc)
+{
+    ofstream out_acc;
+    out_acc.open(filename);
+
+    if(!out_acc)
+    {
+        cerr << "Error: file " + filename + " could not be opened." << endl;
+        return false;
+    }
+
+    out_acc << "block " << acc.block << endl;
+    out_acc << setprecision(17);
+    for(const auto& ja : acc.jobs)
+    {
+        for(unsigned b=0; b<ja.blocks.size(); ++b)
+        {
+            const Moments& m = ja.blocks[b];
+            out_acc << ja.g2 << " " << ja.job << " " << b*acc.block << " " << m.n << " " << m.s1 << " " << m.s2 << " " << m.s4 << endl;
+        }
+    }
+
+    out_acc.close();
+    return true;
+}
+
+bool read_acc(const string& filename, AccFile& acc)
+{
+    ifstream in_acc;
+    in_acc.open(filename);
+
+    if(!in_acc)
+    {
+        cerr << "Error: file " + filename + " could not be opened." << endl;
+        return false;
+    }
+
+    string key;
+    if(!(in_acc >> key >> acc.block) || key != "block" || acc.block < 1)
+    {
+        cerr << "Error: file " + filename + " is not an accumulator file." << endl;
+        return false;
+    }
+
+    // Lines of a job are contiguous and in block order
+    acc.jobs.clear();
+    double g2;
+    int job, first;
+    Moments m;
+    while(in_acc >> g2 >> job >> first >> m.n >> m.s1 >> m.s2 >> m.s4)
+    {
+        if(acc.jobs.empty() || acc.jobs.back().g2 != g2 || acc.jobs.back().job != job)
+            acc.jobs.push_back(JobAcc{g2, job, vector<Moments>()});
+
+        if(first != (int)acc.jobs.back().blocks.size()*acc.block)
+        {
+            cerr << "Error: file " + filename + " has a missing block at g2 " << g2 << ", job " << job << endl;
+            return false;
+        }
+        acc.jobs.back().blocks.push_back(m);
+    }
+
+    if(!in_acc.eof())
+    {
+        cerr << "Error: file " + filename + " could not be parsed." << endl;
+        return false;
+    }
+
+    in_acc.close();
+    return true;
+}
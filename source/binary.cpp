@@ -0,0 +1,416 @@
+#include <armadillo>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include "dataset.hpp"
+#include "parse.hpp"
+#include "cache.hpp"
+#include "sample.hpp"
+#include "index.hpp"
+#include "binary.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Bump when the layout below changes
+static const int32_t BINARY_FORMAT = 3;
+
+// Fixed-size header in front of the sections (native byte order)
+struct BinaryHeader
+{
+    char magic[4];
+    int32_t format;
+    int64_t dim;
+    int64_t n_mat;
+    int64_t n;
+    int64_t packed;
+    int64_t single;
+    int64_t s_size;
+    int64_t s_mtime;
+    uint64_t s_hash;
+    int64_t hl_size;
+    int64_t hl_mtime;
+    uint64_t hl_hash;
+};
+
+string binary_filename(const Dataset& ds, double g2, int job, bool single)
+{
+    return data_path(ds, g2, job) + (single ? "_f.bin" : ".bin");
+}
+
+// Values of one matrix in a section
+static long long matrix_values(long long dim, bool packed)
+{
+    return dim*dim*(packed ? 1 : 2);
+}
+
+static bool same_bits(double a, double b)
+{
+    return !memcmp(&a, &b, sizeof(double));
+}
+
+bool pack_matrix(const cx_mat& M, bool anti, double* p)
+{
+    int dim = M.n_rows;
+    const cx_double* m = M.memptr();
+    for(int k=0; k<dim; ++k)
+    {
+        const cx_double& d = m[k + k*dim];
+        if(!same_bits(anti ? d.real() : d.imag(), 0.))
+            return false;
+        *p++ = anti ? d.imag() : d.real();
+    }
+
+    for(int l=1; l<dim; ++l)
+    {
+        for(int k=0; k<l; ++k)
+        {
+            const cx_double& up = m[k + l*dim];
+            const cx_double& low = m[l + k*dim];
+            if(!same_bits(low.real(), anti ? -up.real() : up.real()) || !same_bits(low.imag(), anti ? up.imag() : -up.imag()))
+                return false;
+            *p++ = up.real();
+            *p++ = up.imag();
+        }
+    }
+    return true;
+}
+
+void unpack_matrix(const double* p, bool anti, cx_mat& M)
+{
+    int dim = M.n_rows;
+    cx_double* m = M.memptr();
+    for(int k=0; k<dim; ++k)
+        m[k + k*dim] = anti ? cx_double(0., p[k]) : cx_double(p[k], 0.);
+    p += dim;
+
+    // The upper part of each column is contiguous, the lower part of the
+    // matching row is its (anti-)conjugate
+    for(int l=1; l<dim; ++l)
+    {
+        for(int k=0; k<l; ++k)
+        {
+            m[k + l*dim] = cx_double(p[2*k], p[2*k+1]);
+            m[l + k*dim] = anti ? cx_double(-p[2*k], p[2*k+1]) : cx_double(p[2*k], -p[2*k+1]);
+        }
+        p += 2*l;
+    }
+}
+
+bool read_text_matrix(TextReader& in, cx_mat& M)
+{
+    int dim = M.n_rows;
+    cx_double* m = M.memptr();
+    for(int k=0; k<dim; ++k)
+    {
+        for(int l=0; l<dim; ++l)
+        {
+            double re, im;
+            if(!in.read(re) || !in.read(im))
+                return false;
+            m[k + l*dim] = cx_double(re, im);
+        }
+    }
+    return true;
+}
+
+// One pass of the conversion into the given file, exact is set to false if
+// packing was asked for and some matrix is not exactly (anti-)Hermitian
+static bool write_sections(const Dataset& ds, double g2, int job, bool packed, bool single, const string& filename, bool& exact)
+{
+    // Samples that are complete in both files
+    SampleIndex idx;
+    FileStamp s, hl;
+    if(!scan_index(ds, g2, job, idx, s, hl) || hl.size < 0)
+        return false;
+    long long n = min(idx.s.size(), idx.hl.size());
+
+    BinaryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "RFLM", 4);
+    h.format = BINARY_FORMAT;
+    h.dim = ds.sm.dim;
+    h.n_mat = ds.nH+ds.nL;
+    h.n = n;
+    h.packed = packed;
+    h.single = single;
+    h.s_size = s.size;
+    h.s_mtime = s.mtime;
+    h.s_hash = s.hash;
+    h.hl_size = hl.size;
+    h.hl_mtime = hl.mtime;
+    h.hl_hash = hl.hash;
+
+    // Every section gets its own stream, so that all of them are written
+    // sequentially while the text is read once
+    {
+        ofstream out;
+        out.open(filename, ios::binary);
+        if(!out || !out.write((const char*)&h, sizeof(h)))
+            return false;
+    }
+
+    int n_mat = h.n_mat;
+    long long n_val = matrix_values(h.dim, packed);
+    long long mat_bytes = n_val*(single ? sizeof(float) : sizeof(double));
+    vector<unique_ptr<fstream>> out(n_mat+1);
+    for(int i=0; i<=n_mat; ++i)
+    {
+        out[i].reset(new fstream(filename, ios::in | ios::out | ios::binary));
+        long long off = sizeof(h) + (i == 0 ? 0 : 2*n*sizeof(double) + (i-1)*n*mat_bytes);
+        if(!*out[i] || !out[i]->seekp(off))
+            return false;
+    }
+
+    string text = data_path(ds, g2, job);
+    TextReader in_s, in_hl;
+    if(!in_s.open(text + "_S.txt") || !in_hl.open(text + "_HL.txt"))
+        return false;
+
+    cx_mat M(h.dim, h.dim);
+    vector<double> buf(n_val);
+    vector<float> fbuf(single ? n_val : 0);
+    for(long long j=0; j<n; ++j)
+    {
+        double S[2];
+        if(!in_s.read(S[0]) || !in_s.read(S[1]))
+            return false;
+        out[0]->write((const char*)S, sizeof(S));
+
+        for(int i=0; i<n_mat; ++i)
+        {
+            if(!read_text_matrix(in_hl, M))
+                return false;
+            const double* v = reinterpret_cast<const double*>(M.memptr());
+            if(packed)
+            {
+                if(!pack_matrix(M, i >= ds.nH, buf.data()))
+                {
+                    exact = false;
+                    return false;
+                }
+                v = buf.data();
+            }
+
+            // Only the matrices are rounded, the action stays in double precision
+            if(single)
+            {
+                for(long long e=0; e<n_val; ++e)
+                    fbuf[e] = v[e];
+                out[i+1]->write((const char*)fbuf.data(), mat_bytes);
+            }
+            else
+                out[i+1]->write((const char*)v, mat_bytes);
+        }
+    }
+
+    for(auto& o : out)
+    {
+        o->close();
+        if(!*o)
+            return false;
+    }
+    return true;
+}
+
+// The copy is written aside and renamed once complete, so that a failed or
+// interrupted conversion never leaves a copy with missing sections
+static bool convert(const Dataset& ds, double g2, int job, bool packed, bool single, bool& exact)
+{
+    string filename = binary_filename(ds, g2, job, single);
+    string tmp = filename + ".tmp";
+    if(!make_job_dir(ds, g2, job))
+        return false;
+
+    if(write_sections(ds, g2, job, packed, single, tmp, exact) && rename(tmp.c_str(), filename.c_str()) == 0)
+        return true;
+    remove(tmp.c_str());
+    return false;
+}
+
+bool write_binary(const Dataset& ds, double g2, int job, bool& packed, bool single)
+{
+    // Jobs that can't be packed exactly are written in full
+    bool exact = true;
+    if(convert(ds, g2, job, packed, single, exact))
+        return true;
+    if(!packed || exact)
+        return false;
+    packed = false;
+    return convert(ds, g2, job, false, single, exact);
+}
+
+bool text_unchanged(const Dataset& ds, double g2, int job, const FileStamp& s, const FileStamp& hl)
+{
+    string text = data_path(ds, g2, job);
+    FileStamp st;
+    if(file_stamp(text + "_S.txt", st) && !file_matches(text + "_S.txt", s))
+        return false;
+    if(file_stamp(text + "_HL.txt", st) && !file_matches(text + "_HL.txt", hl))
+        return false;
+    return true;
+}
+
+// Value of the text as a single precision copy holds it
+static double rounded(double x, bool single)
+{
+    return single ? (double)(float)x : x;
+}
+
+bool compare_with_text(const Dataset& ds, double g2, int job, long long n, const function<bool(Sample&)>& next, long long& n_diff, bool single)
+{
+    string text = data_path(ds, g2, job);
+    TextReader in_s, in_hl;
+    if(!in_s.open(text + "_S.txt") || !in_hl.open(text + "_HL.txt"))
+        return false;
+
+    // Every value has to come back with the same bits
+    n_diff = 0;
+    Sample smp(ds);
+    cx_mat M(ds.sm.dim, ds.sm.dim);
+    for(long long j=0; j<n; ++j)
+    {
+        double S2, S4;
+        if(!next(smp) || !in_s.read(S2) || !in_s.read(S4))
+            return false;
+        n_diff += !same_bits(S2, smp.S2) + !same_bits(S4, smp.S4);
+
+        for(const auto& A : smp.mat)
+        {
+            if(!read_text_matrix(in_hl, M))
+                return false;
+            for(unsigned e=0; e<M.n_elem; ++e)
+                n_diff += !same_bits(rounded(M(e).real(), single), A(e).real()) || !same_bits(rounded(M(e).imag(), single), A(e).imag());
+        }
+    }
+    return true;
+}
+
+bool verify_binary(const Dataset& ds, double g2, int job, long long& n_diff, bool single)
+{
+    BinaryReader bin;
+    if(!bin.open(ds, g2, job, full_projection(ds), single))
+        return false;
+    return compare_with_text(ds, g2, job, bin.size(), [&](Sample& smp) { return bin.read(smp); }, n_diff, single);
+}
+
+bool BinaryReader::open(const Dataset& ds, double g2, int job, const Projection& proj, bool single_)
+{
+    string filename = binary_filename(ds, g2, job, single_);
+    ifstream head;
+    head.open(filename, ios::binary);
+    if(!head)
+        return false;
+
+    BinaryHeader h;
+    if(!head.read((char*)&h, sizeof(h)))
+        return false;
+    if(memcmp(h.magic, "RFLM", 4) || h.format != BINARY_FORMAT || h.dim != ds.sm.dim || h.n_mat != ds.nH+ds.nL || h.n < 0 || h.single != single_)
+        return false;
+
+    // Text files that are gone don't invalidate the copy
+    FileStamp s, hl;
+    s.size = h.s_size;
+    s.mtime = h.s_mtime;
+    s.hash = h.s_hash;
+    hl.size = h.hl_size;
+    hl.mtime = h.hl_mtime;
+    hl.hash = h.hl_hash;
+    if(!text_unchanged(ds, g2, job, s, hl))
+        return false;
+
+    n = h.n;
+    dim = h.dim;
+    n_h = ds.nH;
+    packed = h.packed;
+    single = h.single;
+    n_val = matrix_values(dim, packed);
+    stride = n_val*(single ? sizeof(float) : sizeof(double));
+    long long mat_base = sizeof(h) + 2*n*sizeof(double);
+
+    // A copy cut short has no valid values in its missing sections
+    if(!head.seekg(0, ios::end) || (long long)head.tellg() != mat_base + h.n_mat*n*stride)
+        return false;
+
+    buf.resize(packed ? n_val : 0);
+    fbuf.resize(single ? n_val : 0);
+
+    // Part -1 is the action
+    part.clear();
+    base.clear();
+    if(proj.action)
+    {
+        part.push_back(-1);
+        base.push_back(sizeof(h));
+    }
+    for(const auto& i : proj.mats)
+    {
+        if(i < 0 || i >= h.n_mat)
+            return false;
+        part.push_back(i);
+        base.push_back(mat_base + i*n*stride);
+    }
+
+    in.resize(part.size());
+    for(auto& f : in)
+    {
+        f.reset(new ifstream(filename, ios::binary));
+        if(!*f)
+            return false;
+    }
+    return seek(0);
+}
+
+bool BinaryReader::seek(long long j)
+{
+    if(j < 0 || j > n)
+        return false;
+
+    for(unsigned p=0; p<part.size(); ++p)
+    {
+        in[p]->clear();
+        in[p]->seekg(base[p] + j*(part[p] < 0 ? 2*sizeof(double) : stride));
+    }
+    return true;
+}
+
+bool BinaryReader::read(Sample& smp)
+{
+    for(unsigned p=0; p<part.size(); ++p)
+    {
+        if(part[p] < 0)
+        {
+            double S[2];
+            if(!in[p]->read((char*)S, sizeof(S)))
+                return false;
+            smp.S2 = S[0];
+            smp.S4 = S[1];
+        }
+        else if(!packed && !single)
+        {
+            if(!in[p]->read((char*)smp.mat[part[p]].memptr(), stride))
+                return false;
+        }
+        else
+        {
+            // Single precision values are widened, into the matrix if not packed
+            double* v = packed ? buf.data() : reinterpret_cast<double*>(smp.mat[part[p]].memptr());
+            if(single)
+            {
+                if(!in[p]->read((char*)fbuf.data(), stride))
+                    return false;
+                for(long long e=0; e<n_val; ++e)
+                    v[e] = fbuf[e];
+            }
+            else if(!in[p]->read((char*)v, stride))
+                return false;
+            if(packed)
+                unpack_matrix(v, part[p] >= n_h, smp.mat[part[p]]);
+        }
+    }
+    return true;
+}
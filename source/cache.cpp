@@ -0,0 +1,159 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <sys/stat.h>
+#include "utils.hpp"
+#include "dataset.hpp"
+#include "inflate.hpp"
+#include "compact.hpp"
+#include "cache.hpp"
+
+using namespace std;
+
+
+bool file_stamp(const string& filename, FileStamp& st)
+{
+    // A compacted file keeps the stamp it had when it was packed
+    struct stat info;
+    CompactEntry e;
+    if(stat(stored_file(filename).c_str(), &info) != 0)
+    {
+        if(!find_compacted(filename, e))
+            return false;
+        st.size = e.stamp.size;
+        st.mtime = e.stamp.mtime;
+        return true;
+    }
+
+    st.size = info.st_size;
+    st.mtime = (long long)info.st_mtim.tv_sec*1000000000LL + info.st_mtim.tv_nsec;
+    return true;
+}
+
+bool file_hash(const string& filename, unsigned long long& hash)
+{
+    ifstream in;
+    CompactEntry e;
+    in.open(stored_file(filename), ios::binary);
+    if(!in)
+    {
+        if(!find_compacted(filename, e))
+            return false;
+        hash = e.stamp.hash;
+        return true;
+    }
+
+    hash = 14695981039346656037ULL;
+    vector<char> buf(1 << 20);
+    while(in)
+    {
+        in.read(buf.data(), buf.size());
+        streamsize n = in.gcount();
+        for(streamsize j=0; j<n; ++j)
+        {
+            hash ^= (unsigned char)buf[j];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return in.eof();
+}
+
+bool file_matches(const string& filename, const FileStamp& old)
+{
+    FileStamp st;
+    if(!file_stamp(filename, st) || st.size != old.size)
+        return false;
+    return st.mtime == old.mtime || (file_hash(filename, st.hash) && st.hash == old.hash);
+}
+
+bool make_cache_dir(const Dataset& ds)
+{
+    string dir = ds.path + "/cache";
+    if(mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        cerr << "Error: directory " + dir + " could not be created." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool make_job_dir(const Dataset& ds, double g2, int job)
+{
+    string dir = ds.path + "/" + cc_to_name(g2) + "/" + to_string(job);
+    return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+JobCache::JobCache(const Dataset& ds, double g2, int job, bool read_hl)
+    : stem(ds.path + "/cache/" + cc_to_name(g2) + "_" + to_string(job) + "_"), view(job_view(ds, g2, job)), hashed(false)
+{
+    string filename = data_path(ds, g2, job);
+    files.push_back(filename + "_S.txt");
+    if(read_hl)
+        files.push_back(filename + "_HL.txt");
+
+    // Missing files keep size -1, so that nothing matches them
+    stamps.resize(files.size());
+    for(unsigned f=0; f<files.size(); ++f)
+        file_stamp(files[f], stamps[f]);
+}
+
+bool JobCache::hash_files()
+{
+    if(hashed)
+        return true;
+    for(unsigned f=0; f<files.size(); ++f)
+        if(!file_hash(files[f], stamps[f].hash))
+            return false;
+    hashed = true;
+    return true;
+}
+
+bool JobCache::open(const string& name, const string& tag, ifstream& in)
+{
+    in.open(stem + name + ".txt");
+    if(!in)
+        return false;
+
+    // Header: tag, view (first sample, stride, size), then size, mtime and
+    // hash of every data file
+    string line;
+    if(!getline(in, line) || line != tag)
+        return false;
+
+    JobView old_view;
+    unsigned n_files;
+    if(!(in >> old_view.first >> old_view.stride >> old_view.size >> n_files) || n_files != files.size())
+        return false;
+    if(old_view.first != view.first || old_view.stride != view.stride || old_view.size != view.size)
+        return false;
+
+    for(unsigned f=0; f<files.size(); ++f)
+    {
+        FileStamp old;
+        if(!(in >> old.size >> old.mtime >> old.hash))
+            return false;
+        if(stamps[f].size < 0 || old.size != stamps[f].size)
+            return false;
+        if(old.mtime != stamps[f].mtime && (!hash_files() || old.hash != stamps[f].hash))
+            return false;
+    }
+    return true;
+}
+
+bool JobCache::create(const string& name, const string& tag, ofstream& out)
+{
+    if(!hash_files())
+        return false;
+
+    out.open(stem + name + ".txt");
+    if(!out)
+        return false;
+
+    out << tag << endl;
+    out << view.first << " " << view.stride << " " << view.size << " " << files.size() << endl;
+    for(const auto& st : stamps)
+        out << st.size << " " << st.mtime << " " << st.hash << endl;
+    return true;
+}
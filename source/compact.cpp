@@ -0,0 +1,418 @@
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cstddef>
+#include <sys/stat.h>
+#include "dataset.hpp"
+#include "utils.hpp"
+#include "cache.hpp"
+#include "inflate.hpp"
+#include "sample.hpp"
+#include "index.hpp"
+#include "compact.hpp"
+
+using namespace std;
+
+// Bump when the layout below changes. Format 1 had no generation and
+// named its shards jobs_<k>.bin, it is still read
+static const int32_t COMPACT_FORMAT = 2;
+
+// Longest file name of a job that can be compacted
+static const int NAME_BYTES = 128;
+
+// Fixed-size header of the index (native byte order), followed by one
+// record per file and then by the sample offsets of all files. Every
+// packing writes a new generation of shards, the index names the one it
+// points to
+struct CompactHeader
+{
+    char magic[4];
+    int32_t format;
+    int64_t n_files;
+    int64_t n_shards;
+    int64_t generation;
+};
+
+// Header of format 1, which lacked the generation
+static const size_t HEADER_V1_BYTES = offsetof(CompactHeader, generation);
+
+struct CompactRecord
+{
+    int64_t job;
+    char name[NAME_BYTES];
+    int64_t shard;
+    int64_t offset;
+    int64_t size;
+    int64_t orig_size;
+    int64_t orig_mtime;
+    uint64_t orig_hash;
+    uint64_t text_hash;
+    int64_t n_off;
+    int64_t off_pos;
+};
+
+static string index_file(const string& dir)
+{
+    return dir + "/jobs_idx.bin";
+}
+
+// Shard k of a generation (-1 for the shards of format 1)
+static string shard_file(const string& dir, long long gen, long long k)
+{
+    if(gen < 0)
+        return dir + "/jobs_" + to_string(k) + ".bin";
+    return dir + "/jobs_" + to_string(gen) + "_" + to_string(k) + ".bin";
+}
+
+static void fnv_update(unsigned long long& hash, const char* p, long long n)
+{
+    for(long long j=0; j<n; ++j)
+    {
+        hash ^= (unsigned char)p[j];
+        hash *= 1099511628211ULL;
+    }
+}
+
+// Index of a coupling as last read, reloaded when the file changes
+struct Container
+{
+    long long size;
+    long long mtime;
+    long long generation;
+    vector<CompactRecord> rec;
+    map<pair<int, string>, int> by_name;
+};
+
+static bool load_container(const string& filename, Container& c)
+{
+    ifstream in;
+    in.open(filename, ios::binary);
+    if(!in)
+        return false;
+
+    CompactHeader h;
+    if(!in.read((char*)&h, HEADER_V1_BYTES) || memcmp(h.magic, "RFLJ", 4) || h.n_files < 0)
+        return false;
+    if(h.format == 1)
+        h.generation = -1;
+    else if(h.format != COMPACT_FORMAT || !in.read((char*)&h.generation, sizeof(h.generation)))
+        return false;
+    c.generation = h.generation;
+    c.rec.resize(h.n_files);
+    if(!in.read((char*)c.rec.data(), h.n_files*sizeof(CompactRecord)))
+        return false;
+    c.by_name.clear();
+    for(unsigned r=0; r<c.rec.size(); ++r)
+    {
+        c.rec[r].name[NAME_BYTES-1] = '\0';
+        c.by_name[make_pair((int)c.rec[r].job, string(c.rec[r].name))] = r;
+    }
+    return true;
+}
+
+// Containers are shared by all the readers of the process
+static mutex containers_mtx;
+static map<string, shared_ptr<const Container>> containers;
+
+static long long stat_mtime(const struct stat& info)
+{
+    return (long long)info.st_mtim.tv_sec*1000000000LL + info.st_mtim.tv_nsec;
+}
+
+static shared_ptr<const Container> find_container(const string& dir)
+{
+    string filename = index_file(dir);
+    struct stat info;
+    if(stat(filename.c_str(), &info) != 0)
+        return nullptr;
+    long long mtime = stat_mtime(info);
+
+    lock_guard<mutex> lock(containers_mtx);
+    auto it = containers.find(dir);
+    if(it != containers.end() && it->second->size == info.st_size && it->second->mtime == mtime)
+        return it->second;
+
+    shared_ptr<Container> c(new Container);
+    c->size = info.st_size;
+    c->mtime = mtime;
+    if(!load_container(filename, *c))
+        return nullptr;
+    containers[dir] = c;
+    return c;
+}
+
+// Split path/<g2>/<job>/<name> into the coupling folder, job and name
+static bool split_path(const string& filename, string& dir, int& job, string& name)
+{
+    size_t s1 = filename.rfind('/');
+    if(s1 == string::npos || s1 == 0)
+        return false;
+    size_t s0 = filename.rfind('/', s1-1);
+    if(s0 == string::npos)
+        return false;
+
+    string job_str = filename.substr(s0+1, s1-s0-1);
+    if(job_str.empty() || job_str.find_first_not_of("0123456789") != string::npos)
+        return false;
+    dir = filename.substr(0, s0);
+    job = stoi(job_str);
+    name = filename.substr(s1+1);
+    return true;
+}
+
+// Record of a job file and its container
+static const CompactRecord* find_record(const string& filename, shared_ptr<const Container>& c, string& dir)
+{
+    int job;
+    string name;
+    if(!split_path(filename, dir, job, name) || !(c = find_container(dir)))
+        return nullptr;
+    auto it = c->by_name.find(make_pair(job, name));
+    return it == c->by_name.end() ? nullptr : &c->rec[it->second];
+}
+
+bool find_compacted(const string& filename, CompactEntry& e)
+{
+    shared_ptr<const Container> c;
+    string dir;
+    const CompactRecord* r = find_record(filename, c, dir);
+    if(!r)
+        return false;
+
+    e.shard = shard_file(dir, c->generation, r->shard);
+    e.offset = r->offset;
+    e.size = r->size;
+    e.stamp.size = r->orig_size;
+    e.stamp.mtime = r->orig_mtime;
+    e.stamp.hash = r->orig_hash;
+    return true;
+}
+
+// Sample offsets of one compacted file, read from the index the record
+// came from. False if the index was replaced in the meantime
+static bool read_offsets_once(const string& filename, vector<streamoff>& off, bool& replaced)
+{
+    replaced = false;
+    shared_ptr<const Container> c;
+    string dir;
+    const CompactRecord* r = find_record(filename, c, dir);
+    if(!r)
+        return false;
+
+    // A file put back in place after compacting must still be the same
+    FileStamp st;
+    st.size = r->orig_size;
+    st.mtime = r->orig_mtime;
+    st.hash = r->orig_hash;
+    if(!file_matches(filename, st))
+        return false;
+
+    FILE* in = fopen(index_file(dir).c_str(), "rb");
+    if(!in)
+        return false;
+    struct stat info;
+    vector<int64_t> temp(r->n_off);
+    bool ok = fstat(fileno(in), &info) == 0;
+    replaced = ok && (info.st_size != c->size || stat_mtime(info) != c->mtime);
+    ok = ok && !replaced && fseeko(in, r->off_pos, SEEK_SET) == 0 && fread(temp.data(), sizeof(int64_t), temp.size(), in) == temp.size();
+    fclose(in);
+    if(!ok)
+        return false;
+    off.assign(temp.begin(), temp.end());
+    return true;
+}
+
+static bool read_offsets(const string& filename, vector<streamoff>& off)
+{
+    // An index replaced by a packing that finished meanwhile is read again
+    bool replaced = false;
+    for(int attempt=0; attempt<2; ++attempt)
+    {
+        if(read_offsets_once(filename, off, replaced))
+            return true;
+        if(!replaced)
+            return false;
+    }
+    return false;
+}
+
+bool compacted_index(const Dataset& ds, double g2, int job, bool read_hl, SampleIndex& idx)
+{
+    string filename = data_path(ds, g2, job);
+    if(!read_offsets(filename + "_S.txt", idx.s))
+        return false;
+    idx.hl.clear();
+    return !read_hl || read_offsets(filename + "_HL.txt", idx.hl);
+}
+
+// Copy a job file through its byte source, hashing the text on the way
+static bool copy_text(const string& filename, ofstream& out, long long& size, unsigned long long& hash)
+{
+    unique_ptr<ByteSource> in = open_source(filename);
+    if(!in)
+        return false;
+
+    vector<char> buf(1 << 20);
+    size = 0;
+    hash = 14695981039346656037ULL;
+    while(true)
+    {
+        long long n = in->read(buf.data(), buf.size());
+        if(n < 0)
+            return false;
+        if(n == 0)
+            break;
+        fnv_update(hash, buf.data(), n);
+        out.write(buf.data(), n);
+        size += n;
+    }
+    return (bool)out;
+}
+
+bool compact_coupling(const Dataset& ds, double g2, long long shard_bytes)
+{
+    string dir = ds.path + "/" + cc_to_name(g2);
+    vector<CompactRecord> rec;
+    vector<vector<int64_t>> offsets;
+
+    // New shards are a new generation, the old ones may be the source and
+    // stay in use until the new index replaces the old one
+    shared_ptr<const Container> old = find_container(dir);
+    long long gen = old ? old->generation + 1 : 0;
+    long long shard = 0;
+    long long used = 0;
+    ofstream out;
+    out.open(shard_file(dir, gen, shard), ios::binary);
+    if(!out)
+        return false;
+
+    for(const auto& job : ds.job_vec)
+    {
+        SampleIndex idx;
+        FileStamp s, hl;
+        if(!scan_index(ds, g2, job, idx, s, hl))
+            return false;
+
+        // A job goes to the next shard if this one is full
+        if(used >= shard_bytes)
+        {
+            out.close();
+            if(!out)
+                return false;
+            out.open(shard_file(dir, gen, ++shard), ios::binary);
+            used = 0;
+            if(!out)
+                return false;
+        }
+
+        string filename = data_path(ds, g2, job);
+        for(int f=0; f<2; ++f)
+        {
+            const FileStamp& st = f == 0 ? s : hl;
+            if(st.size < 0)
+                continue;
+
+            string suffix = f == 0 ? "_S.txt" : "_HL.txt";
+            string name = filename.substr(filename.rfind('/')+1) + suffix;
+            if((int)name.size() >= NAME_BYTES)
+                return false;
+
+            CompactRecord r;
+            memset(&r, 0, sizeof(r));
+            r.job = job;
+            strcpy(r.name, name.c_str());
+            r.shard = shard;
+            r.offset = used;
+            r.orig_size = st.size;
+            r.orig_mtime = st.mtime;
+            r.orig_hash = st.hash;
+            long long size;
+            unsigned long long hash;
+            if(!copy_text(filename + suffix, out, size, hash))
+                return false;
+            r.size = size;
+            r.text_hash = hash;
+            used += size;
+
+            const vector<streamoff>& off = f == 0 ? idx.s : idx.hl;
+            offsets.push_back(vector<int64_t>(off.begin(), off.end()));
+            r.n_off = off.size();
+            rec.push_back(r);
+        }
+    }
+    out.close();
+    if(!out)
+        return false;
+
+    CompactHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "RFLJ", 4);
+    h.format = COMPACT_FORMAT;
+    h.n_files = rec.size();
+    h.n_shards = shard+1;
+    h.generation = gen;
+
+    long long pos = sizeof(h) + rec.size()*sizeof(CompactRecord);
+    for(unsigned r=0; r<rec.size(); ++r)
+    {
+        rec[r].off_pos = pos;
+        pos += offsets[r].size()*sizeof(int64_t);
+    }
+
+    string filename = index_file(dir);
+    out.open(filename + ".tmp", ios::binary);
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)rec.data(), rec.size()*sizeof(CompactRecord));
+    for(const auto& off : offsets)
+        out.write((const char*)off.data(), off.size()*sizeof(int64_t));
+    out.close();
+    if(!out)
+        return false;
+
+    // A single rename switches readers to the new generation
+    if(rename((filename + ".tmp").c_str(), filename.c_str()) != 0)
+        return false;
+
+    // Only now are the shards of earlier packings unused, including those
+    // left over by packings that didn't finish
+    for(long long g=-1; g<gen; ++g)
+        for(long long k=0; remove(shard_file(dir, g, k).c_str()) == 0; ++k);
+    for(long long k=shard+1; remove(shard_file(dir, gen, k).c_str()) == 0; ++k);
+    return true;
+}
+
+bool verify_compacted(const Dataset& ds, double g2, long long& n_bad)
+{
+    string dir = ds.path + "/" + cc_to_name(g2);
+    shared_ptr<const Container> c = find_container(dir);
+    if(!c)
+        return false;
+
+    n_bad = 0;
+    vector<char> buf(1 << 20);
+    for(const auto& r : c->rec)
+    {
+        ifstream in;
+        in.open(shard_file(dir, c->generation, r.shard), ios::binary);
+        in.seekg(r.offset);
+        if(!in)
+            return false;
+
+        unsigned long long hash = 14695981039346656037ULL;
+        long long left = r.size;
+        while(left > 0 && in)
+        {
+            in.read(buf.data(), min(left, (long long)buf.size()));
+            fnv_update(hash, buf.data(), in.gcount());
+            left -= in.gcount();
+        }
+        n_bad += left > 0 || hash != r.text_hash;
+    }
+    return true;
+}
@@ -0,0 +1,445 @@
+#include <armadillo>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "dataset.hpp"
+#include "parse.hpp"
+#include "cache.hpp"
+#include "parallel.hpp"
+#include "sample.hpp"
+#include "index.hpp"
+#include "binary.hpp"
+#include "compress.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Bump when the layout or the codec below change
+static const int32_t COMPRESS_FORMAT = 1;
+
+// Fixed-size header in front of the chunks (native byte order)
+struct CompressHeader
+{
+    char magic[4];
+    int32_t format;
+    int64_t dim;
+    int64_t n_mat;
+    int64_t n;
+    int64_t packed;
+    int64_t chunk;
+    int64_t index;
+    int64_t s_size;
+    int64_t s_mtime;
+    uint64_t s_hash;
+    int64_t hl_size;
+    int64_t hl_mtime;
+    uint64_t hl_hash;
+};
+
+// Bits go into 64-bit words starting from the least significant end
+class BitWriter
+{
+    private:
+        vector<uint64_t>& out;
+        uint64_t cur;
+        int used;
+
+    public:
+        BitWriter(vector<uint64_t>& out_) : out(out_), cur(0), used(0) {}
+
+        // The lowest b bits of v, 1 <= b <= 64
+        void put(uint64_t v, int b)
+        {
+            cur |= v << used;
+            if(used + b < 64)
+            {
+                used += b;
+                return;
+            }
+            out.push_back(cur);
+            cur = used ? v >> (64-used) : 0;
+            used += b - 64;
+        }
+
+        void flush()
+        {
+            if(used)
+                out.push_back(cur);
+            cur = 0;
+            used = 0;
+        }
+};
+
+class BitReader
+{
+    private:
+        const uint64_t* w;
+        long long n;
+        long long i;
+        uint64_t cur;
+        int used;
+
+    public:
+        bool bad;
+
+        BitReader(const uint64_t* w_, long long n_) : w(w_), n(n_), i(1), cur(n_ ? w_[0] : 0), used(0), bad(false) {}
+
+        // Next b bits, 0 <= b <= 64
+        uint64_t get(int b)
+        {
+            uint64_t v = cur >> used;
+            if(used + b < 64)
+                used += b;
+            else
+            {
+                int got = 64 - used;
+                cur = i < n ? w[i] : 0;
+                if(got < b)
+                {
+                    bad |= i >= n;
+                    v |= cur << got;
+                }
+                ++i;
+                used += b - 64;
+            }
+            return b == 64 ? v : v & ((1ULL << b) - 1);
+        }
+};
+
+// Stream of n_smp samples of n_val values each. A value equal to the one
+// of the previous sample costs one bit, otherwise the XOR of the two is
+// written as its meaningful bits, reusing the window of leading and
+// trailing zeros of the last XOR of the same value when it fits
+static void encode_stream(const double* v, long long n_smp, int n_val, vector<uint64_t>& out)
+{
+    BitWriter w(out);
+    vector<uint64_t> prev(n_val, 0);
+    vector<int> lead(n_val, 64);
+    vector<int> len(n_val, 0);
+    for(long long j=0; j<n_smp; ++j)
+    {
+        for(int e=0; e<n_val; ++e)
+        {
+            uint64_t b;
+            memcpy(&b, v + j*n_val + e, sizeof(b));
+            uint64_t x = b ^ prev[e];
+            prev[e] = b;
+            if(!x)
+            {
+                w.put(0, 1);
+                continue;
+            }
+
+            int lz = __builtin_clzll(x);
+            int tz = __builtin_ctzll(x);
+            if(lz >= lead[e] && tz >= 64-lead[e]-len[e])
+            {
+                // Control bits 1 0
+                w.put(1, 2);
+                w.put(x >> (64-lead[e]-len[e]), len[e]);
+                continue;
+            }
+
+            // Control bits 1 1, then 6 bits of leading zeros and 6 of length
+            lead[e] = lz;
+            len[e] = 64 - lz - tz;
+            w.put(3 | (uint64_t)lz << 2 | (uint64_t)(len[e]-1) << 8, 14);
+            w.put(x >> tz, len[e]);
+        }
+    }
+    w.flush();
+}
+
+static bool decode_stream(const uint64_t* words, long long n_words, long long n_smp, int n_val, double* v)
+{
+    BitReader r(words, n_words);
+    vector<uint64_t> prev(n_val, 0);
+    vector<int> trail(n_val, 0);
+    vector<int> len(n_val, 0);
+    for(long long j=0; j<n_smp; ++j)
+    {
+        for(int e=0; e<n_val; ++e)
+        {
+            if(r.get(1))
+            {
+                if(r.get(1))
+                {
+                    int lead = r.get(6);
+                    len[e] = r.get(6) + 1;
+                    trail[e] = 64 - lead - len[e];
+                    if(trail[e] < 0)
+                        return false;
+                }
+                prev[e] ^= r.get(len[e]) << trail[e];
+            }
+            memcpy(v + j*n_val + e, &prev[e], sizeof(double));
+        }
+    }
+    return !r.bad;
+}
+
+string compressed_filename(const Dataset& ds, double g2, int job)
+{
+    return data_path(ds, g2, job) + "_z.bin";
+}
+
+// Values of part p of a sample: the action, or matrix p-1
+static int part_values(int p, long long dim, bool packed)
+{
+    return p == 0 ? 2 : dim*dim*(packed ? 1 : 2);
+}
+
+// One pass of the compression, exact is set to false if packing was asked
+// for and some matrix is not exactly (anti-)Hermitian
+static bool compress(const Dataset& ds, double g2, int job, int chunk, bool packed, bool& exact, double& ratio)
+{
+    // Samples that are complete in both files
+    SampleIndex idx;
+    FileStamp s, hl;
+    if(!scan_index(ds, g2, job, idx, s, hl) || hl.size < 0)
+        return false;
+    long long n = min(idx.s.size(), idx.hl.size());
+
+    CompressHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "RFLZ", 4);
+    h.format = COMPRESS_FORMAT;
+    h.dim = ds.sm.dim;
+    h.n_mat = ds.nH+ds.nL;
+    h.n = n;
+    h.packed = packed;
+    h.chunk = chunk;
+    h.s_size = s.size;
+    h.s_mtime = s.mtime;
+    h.s_hash = s.hash;
+    h.hl_size = hl.size;
+    h.hl_mtime = hl.mtime;
+    h.hl_hash = hl.hash;
+
+    string filename = compressed_filename(ds, g2, job);
+    ofstream out;
+    if(!make_job_dir(ds, g2, job))
+        return false;
+    out.open(filename, ios::binary);
+    if(!out || !out.write((const char*)&h, sizeof(h)))
+        return false;
+
+    string text = data_path(ds, g2, job);
+    TextReader in_s, in_hl;
+    if(!in_s.open(text + "_S.txt") || !in_hl.open(text + "_HL.txt"))
+        return false;
+
+    // Each chunk is read whole, then its parts are encoded one by one
+    int n_parts = h.n_mat+1;
+    vector<vector<double>> vals(n_parts);
+    for(int p=0; p<n_parts; ++p)
+        vals[p].resize(chunk*part_values(p, h.dim, packed));
+
+    vector<int64_t> off;
+    vector<uint64_t> words;
+    cx_mat M(h.dim, h.dim);
+    for(long long c=0; c*chunk<n; ++c)
+    {
+        long long n_smp = min((long long)chunk, n-c*chunk);
+        for(long long j=0; j<n_smp; ++j)
+        {
+            if(!in_s.read(vals[0][2*j]) || !in_s.read(vals[0][2*j+1]))
+                return false;
+
+            for(int p=1; p<n_parts; ++p)
+            {
+                double* v = vals[p].data() + j*part_values(p, h.dim, packed);
+                if(!read_text_matrix(in_hl, M))
+                    return false;
+                if(!packed)
+                    memcpy(v, M.memptr(), M.n_elem*sizeof(cx_double));
+                else if(!pack_matrix(M, p-1 >= ds.nH, v))
+                {
+                    exact = false;
+                    return false;
+                }
+            }
+        }
+
+        for(int p=0; p<n_parts; ++p)
+        {
+            off.push_back(out.tellp());
+            words.clear();
+            encode_stream(vals[p].data(), n_smp, part_values(p, h.dim, packed), words);
+            out.write((const char*)words.data(), words.size()*sizeof(uint64_t));
+        }
+    }
+    off.push_back(out.tellp());
+
+    // The index goes at the end, its position in the header
+    h.index = off.back();
+    out.write((const char*)off.data(), off.size()*sizeof(int64_t));
+    out.seekp(0);
+    out.write((const char*)&h, sizeof(h));
+    out.close();
+
+    double full = n*(2 + h.n_mat*2*h.dim*h.dim)*sizeof(double);
+    ratio = n ? (h.index - sizeof(h))/full : 1.;
+    return (bool)out;
+}
+
+bool write_compressed(const Dataset& ds, double g2, int job, int chunk, bool& packed, double& ratio)
+{
+    // Jobs that can't be packed exactly are written in full
+    bool exact = true;
+    if(chunk < 1)
+        return false;
+    if(compress(ds, g2, job, chunk, packed, exact, ratio))
+        return true;
+    if(!packed || exact)
+        return false;
+    packed = false;
+    return compress(ds, g2, job, chunk, false, exact, ratio);
+}
+
+bool verify_compressed(const Dataset& ds, double g2, int job, long long& n_diff)
+{
+    CompressedReader zip;
+    if(!zip.open(ds, g2, job, full_projection(ds)))
+        return false;
+    return compare_with_text(ds, g2, job, zip.size(), [&](Sample& smp) { return zip.read(smp); }, n_diff);
+}
+
+bool CompressedReader::open(const Dataset& ds, double g2, int job, const Projection& proj)
+{
+    in.open(compressed_filename(ds, g2, job), ios::binary);
+    if(!in)
+        return false;
+
+    CompressHeader h;
+    if(!in.read((char*)&h, sizeof(h)))
+        return false;
+    if(memcmp(h.magic, "RFLZ", 4) || h.format != COMPRESS_FORMAT || h.dim != ds.sm.dim || h.n_mat != ds.nH+ds.nL || h.n < 0 || h.chunk < 1)
+        return false;
+
+    // Text files that are gone don't invalidate the copy
+    FileStamp s, hl;
+    s.size = h.s_size;
+    s.mtime = h.s_mtime;
+    s.hash = h.s_hash;
+    hl.size = h.hl_size;
+    hl.mtime = h.hl_mtime;
+    hl.hash = h.hl_hash;
+    if(!text_unchanged(ds, g2, job, s, hl))
+        return false;
+
+    n = h.n;
+    chunk = h.chunk;
+    dim = h.dim;
+    n_h = ds.nH;
+    packed = h.packed;
+    n_parts = h.n_mat+1;
+
+    // Stream p of chunk c spans off[c*n_parts+p] to the next offset
+    long long n_chunks = (n + chunk-1)/chunk;
+    off.resize(n_chunks*n_parts+1);
+    in.seekg(h.index);
+    if(!in.read((char*)off.data(), off.size()*sizeof(int64_t)))
+        return false;
+    for(unsigned k=0; k<off.size(); ++k)
+        if(off[k] < (int64_t)sizeof(h) || (k && off[k] < off[k-1]) || (off[k]-off[0]) % sizeof(uint64_t))
+            return false;
+
+    // Part 0 is the action, part i+1 matrix i
+    part.clear();
+    n_val.clear();
+    if(proj.action)
+        part.push_back(0);
+    for(const auto& i : proj.mats)
+    {
+        if(i < 0 || i >= h.n_mat)
+            return false;
+        part.push_back(i+1);
+    }
+    for(const auto& p : part)
+        n_val.push_back(part_values(p, dim, packed));
+    dec.resize(part.size());
+
+    first = 0;
+    n_dec = 0;
+    return seek(0);
+}
+
+bool CompressedReader::decode(long long c0)
+{
+    // The streams of a few chunks are read in turn, then decoded in parallel
+    long long n_chunks = (n + chunk-1)/chunk;
+    int n_c = min((long long)n_thr, n_chunks-c0);
+    int n_p = part.size();
+    first = c0*chunk;
+    n_dec = min(n, (c0+n_c)*chunk) - first;
+    words.resize(n_c*n_p);
+    for(int c=0; c<n_c; ++c)
+    {
+        for(int q=0; q<n_p; ++q)
+        {
+            long long k = (c0+c)*n_parts + part[q];
+            vector<uint64_t>& w = words[c*n_p+q];
+            w.resize((off[k+1]-off[k])/sizeof(uint64_t));
+            in.clear();
+            in.seekg(off[k]);
+            if(!in.read((char*)w.data(), w.size()*sizeof(uint64_t)))
+                return false;
+        }
+    }
+
+    for(int q=0; q<n_p; ++q)
+        dec[q].resize(n_dec*n_val[q]);
+
+    vector<char> ok(n_c*n_p, 1);
+    parallel_for(0, n_c*n_p, [&](int k, int)
+    {
+        int c = k/n_p;
+        int q = k%n_p;
+        long long n_smp = min((long long)chunk, n_dec-c*chunk);
+        ok[k] = decode_stream(words[k].data(), words[k].size(), n_smp, n_val[q], dec[q].data() + c*chunk*n_val[q]);
+    }, n_thr);
+
+    if(find(ok.begin(), ok.end(), 0) != ok.end())
+    {
+        n_dec = 0;
+        return false;
+    }
+    return true;
+}
+
+bool CompressedReader::seek(long long j)
+{
+    if(j < 0 || j > n)
+        return false;
+    pos = j;
+    return true;
+}
+
+bool CompressedReader::read(Sample& smp)
+{
+    if(pos >= n)
+        return false;
+    if(pos < first || pos >= first+n_dec)
+        if(!decode(pos/chunk))
+            return false;
+
+    for(unsigned q=0; q<part.size(); ++q)
+    {
+        const double* v = dec[q].data() + (pos-first)*n_val[q];
+        if(part[q] == 0)
+        {
+            smp.S2 = v[0];
+            smp.S4 = v[1];
+        }
+        else if(!packed)
+            memcpy((void*)smp.mat[part[q]-1].memptr(), v, n_val[q]*sizeof(double));
+        else
+            unpack_matrix(v, part[q]-1 >= n_h, smp.mat[part[q]-1]);
+    }
+    ++pos;
+    return true;
+}
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <cstdio>
+#include "geometry.hpp"
+#include "utils.hpp"
+#include "params.hpp"
+#include "dataset.hpp"
+
+using namespace std;
+
+
+bool read_dataset(const string& path, Dataset& ds)
+{
+    ds.path = path;
+    ds.prefix = "GEOM";
+
+    // Read simulation parameters from file path/init.txt
+    string init_filename = path + "/init.txt";
+
+    ifstream in_init;
+    in_init.open(init_filename);
+
+    if(!read_init_stream(in_init, ds.sm))
+    {
+        cerr << "Error: couldn't read file " + init_filename << endl;
+        return false;
+    }
+
+    cout << "File " + init_filename + " contains the following parameters:" << endl;
+    cout << ds.sm.control << endl;
+
+    if(!params_validity(ds.sm))
+    {
+        cerr << "Error: file " + init_filename + " does not contain the necessary parameters." << endl;
+        return false;
+    }
+
+    in_init.close();
+
+    // Number of matrices per sample depends on the geometry only
+    Geom24 G(ds.sm.p, ds.sm.q, ds.sm.dim, 0.);
+    ds.nH = G.get_nH();
+    ds.nL = G.get_nL();
+
+
+    // Read coupling constants from file path/g2_val.txt
+    string g2_filename = path + "/g2_val.txt";
+
+    ifstream in_g2;
+    in_g2.open(g2_filename);
+
+    if(!in_g2.is_open())
+    {
+        cerr << "Error: couldn't read file " + g2_filename << endl;
+        return false;
+    }
+
+    ds.g2_vec.clear();
+    double temp_g2;
+    while(in_g2 >> temp_g2)
+        ds.g2_vec.push_back(temp_g2);
+
+    if(ds.g2_vec.empty())
+    {
+        cerr << "Error: file " + g2_filename + " contains no g2 value." << endl;
+        return false;
+    }
+    
+    cout << "File " + g2_filename + " contains " << ds.g2_vec.size() << " g2 values:" << endl;
+    cout << "From " << *ds.g2_vec.begin() << " to " << *(ds.g2_vec.end()-1) << endl;
+
+    in_g2.close();
+
+
+    // Read job indices from file path/job_idx.txt
+    string job_filename = path + "/job_idx.txt";
+
+    ifstream in_job;
+    in_job.open(job_filename);
+
+    if(!in_job.is_open())
+    {
+        cerr << "Error: couldn't read file " + job_filename << endl;
+        return false;
+    }
+
+    ds.job_vec.clear();
+    int temp_job;
+    while(in_job >> temp_job)
+        ds.job_vec.push_back(temp_job);
+
+    if(ds.job_vec.empty())
+    {
+        cerr << "Error: file " + job_filename + " contains no job index." << endl;
+        return false;
+    }
+    
+    cout << "File " + job_filename + " contains " << ds.job_vec.size() << " job indices:" << endl;
+    cout << "From " << *ds.job_vec.begin() << " to " << *(ds.job_vec.end()-1) << endl;
+
+    in_job.close();
+
+
+    // Read burn-in cuts, if any
+    if(!read_burnin(path, ds.burnin))
+        return false;
+
+    if(!ds.burnin.empty())
+        cout << "File " + path + "/burnin.txt contains " << ds.burnin.size() << " burn-in cuts" << endl;
+
+    // Read decimation view, if any
+    if(!read_decimation(path, ds.dec))
+        return false;
+
+    if(ds.dec.stride > 1 || ds.dec.cut || ds.dec.offset || ds.dec.max)
+    {
+        cout << "File " + path + "/decimation.txt sets the view:" << endl;
+        cout << "cut " << ds.dec.cut << ", offset " << ds.dec.offset << ", stride " << ds.dec.stride << ", max " << ds.dec.max << endl;
+    }
+
+    // Warn once about the jobs the view would leave empty
+    for(const auto& g2 : ds.g2_vec)
+        for(const auto& job : ds.job_vec)
+            job_view(ds.burnin, ds.dec, g2, job, ds.sm.samples);
+
+    return true;
+}
+
+bool read_burnin(const string& path, map<string, int>& burnin)
+{
+    burnin.clear();
+
+    string burnin_filename = path + "/burnin.txt";
+    ifstream in_burnin;
+    in_burnin.open(burnin_filename);
+
+    // No index, no cut
+    if(!in_burnin.is_open())
+        return true;
+
+    double g2;
+    int job, cut;
+    while(in_burnin >> g2 >> job >> cut)
+        burnin[burnin_key(g2, job)] = cut;
+
+    if(!in_burnin.eof())
+    {
+        cerr << "Error: file " + burnin_filename + " is not in the format g2 job cut" << endl;
+        return false;
+    }
+
+    in_burnin.close();
+    return true;
+}
+
+string burnin_key(double g2, int job)
+{
+    return cc_to_name(g2) + "/" + to_string(job);
+}
+
+int burnin_cut(const Dataset& ds, double g2, int job)
+{
+    auto it = ds.burnin.find(burnin_key(g2, job));
+    return it == ds.burnin.end() ? 0 : it->second;
+}
+
+bool read_decimation(const string& path, Decimation& dec)
+{
+    dec = Decimation();
+
+    string dec_filename = path + "/decimation.txt";
+    ifstream in_dec;
+    in_dec.open(dec_filename);
+
+    // No file, every sample
+    if(!in_dec.is_open())
+        return true;
+
+    string key;
+    int value;
+    while(in_dec >> key >> value)
+    {
+        if(key == "cut")
+            dec.cut = value;
+        else if(key == "offset")
+            dec.offset = value;
+        else if(key == "stride")
+            dec.stride = value;
+        else if(key == "max")
+            dec.max = value;
+        else
+        {
+            cerr << "Error: file " + dec_filename + " has unknown key " + key << endl;
+            return false;
+        }
+    }
+
+    if(!in_dec.eof())
+    {
+        cerr << "Error: file " + dec_filename + " is not in the format key value" << endl;
+        return false;
+    }
+
+    if(dec.cut < 0 || dec.offset < 0 || dec.stride < 1 || dec.max < 0)
+    {
+        cerr << "Error: file " + dec_filename + " needs stride >= 1 and the rest >= 0" << endl;
+        return false;
+    }
+
+    in_dec.close();
+    return true;
+}
+
+bool write_decimation(const string& path, const Decimation& dec)
+{
+    string dec_filename = path + "/decimation.txt";
+    if(dec.stride == 1 && !dec.cut && !dec.offset && !dec.max)
+        return remove(dec_filename.c_str()) == 0 || !ifstream(dec_filename);
+
+    ofstream out_dec;
+    out_dec.open(dec_filename);
+
+    if(!out_dec)
+    {
+        cerr << "Error: file " + dec_filename + " could not be opened." << endl;
+        return false;
+    }
+
+    out_dec << "cut " << dec.cut << endl;
+    out_dec << "offset " << dec.offset << endl;
+    out_dec << "stride " << dec.stride << endl;
+    out_dec << "max " << dec.max << endl;
+
+    out_dec.close();
+    return (bool)out_dec;
+}
+
+// View of a job with n samples and the given burn-in cut. If nothing is left
+// only the last sample is kept, so that readers always have one
+static JobView clamped_view(int burn, const Decimation& dec, int n, bool& clamped)
+{
+    JobView v;
+    long long first = (long long)max(burn, dec.cut) + dec.offset;
+    clamped = first >= n;
+    v.first = clamped ? max(n-1, 0) : first;
+    v.stride = dec.stride;
+    v.size = (n - v.first + v.stride-1)/v.stride;
+    if(dec.max > 0)
+        v.size = min(v.size, dec.max);
+    return v;
+}
+
+JobView job_view(const Dataset& ds, double g2, int job)
+{
+    // read_dataset warned already
+    bool clamped;
+    return clamped_view(burnin_cut(ds, g2, job), ds.dec, ds.sm.samples, clamped);
+}
+
+JobView job_view(const map<string, int>& burnin, const Decimation& dec, double g2, int job, int n)
+{
+    auto it = burnin.find(burnin_key(g2, job));
+    bool clamped;
+    JobView v = clamped_view(it == burnin.end() ? 0 : it->second, dec, n, clamped);
+    if(clamped)
+        clog << "Warning: burn-in cut and decimation of job " << job << " at g2 " << g2 << " leave no samples, only the last one is kept" << endl;
+    return v;
+}
+
+void skip_s(istream& in_s, int n)
+{
+    for(int j=0; j<n && in_s; ++j)
+        in_s.ignore(numeric_limits<streamsize>::max(), '\n');
+}
+
+void skip_hl(istream& in_hl, int n, const struct Simul_params& sm)
+{
+    // Each matrix is written on its own line
+    Geom24 G(sm.p, sm.q, sm.dim, 0.);
+    skip_s(in_hl, n*G.get_nHL());
+}
+
+void skip_stride_s(istream& in_s, const JobView& v)
+{
+    // The rest of the line of the sample just read, then stride-1 lines
+    if(v.stride > 1)
+        skip_s(in_s, v.stride);
+}
+
+void skip_stride_hl(istream& in_hl, const JobView& v, const struct Simul_params& sm)
+{
+    if(v.stride > 1 && in_hl)
+    {
+        skip_s(in_hl, 1);
+        skip_hl(in_hl, v.stride-1, sm);
+    }
+}
+
+string data_path(const Dataset& ds, double g2, int job)
+{
+    string array_path = ds.path + "/" + cc_to_name(g2) + "/" + to_string(job);
+    string filename = data_to_name(ds.sm.p, ds.sm.q, ds.sm.dim, g2, ds.prefix);
+    return array_path + "/" + filename;
+}
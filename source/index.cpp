@@ -0,0 +1,143 @@
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include "dataset.hpp"
+#include "parse.hpp"
+#include "cache.hpp"
+#include "sample.hpp"
+#include "compact.hpp"
+#include "index.hpp"
+
+using namespace std;
+
+// Bump when the layout below changes
+static const int32_t INDEX_FORMAT = 1;
+
+// Fixed-size header in front of the offsets (native byte order): the S
+// offsets come first, then the HL ones
+struct IndexHeader
+{
+    char magic[4];
+    int32_t format;
+    int64_t n_mat;
+    int64_t s_size;
+    int64_t s_mtime;
+    uint64_t s_hash;
+    int64_t hl_size;
+    int64_t hl_mtime;
+    uint64_t hl_hash;
+    int64_t n_s;
+    int64_t n_hl;
+};
+
+string index_filename(const Dataset& ds, double g2, int job)
+{
+    return data_path(ds, g2, job) + "_idx.bin";
+}
+
+// Offset of the first line of every group of n lines (a trailing
+// incomplete group is left out)
+static bool scan_lines(const string& filename, long long n, vector<streamoff>& off)
+{
+    TextReader in;
+    if(!in.open(filename))
+        return false;
+
+    off.clear();
+    while(true)
+    {
+        long long start = in.tell();
+        if(!in.skip_lines(n))
+            break;
+        off.push_back(start);
+    }
+    return true;
+}
+
+bool scan_index(const Dataset& ds, double g2, int job, SampleIndex& idx, FileStamp& s, FileStamp& hl)
+{
+    // The S file is required, HL may be missing
+    string filename = data_path(ds, g2, job);
+    if(!file_stamp(filename + "_S.txt", s) || !file_hash(filename + "_S.txt", s.hash) || !scan_lines(filename + "_S.txt", 1, idx.s))
+        return false;
+    idx.hl.clear();
+    if(file_stamp(filename + "_HL.txt", hl) && (!file_hash(filename + "_HL.txt", hl.hash) || !scan_lines(filename + "_HL.txt", ds.nH+ds.nL, idx.hl)))
+        return false;
+    return true;
+}
+
+bool write_index(const Dataset& ds, double g2, int job)
+{
+    IndexHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "RFLI", 4);
+    h.format = INDEX_FORMAT;
+    h.n_mat = ds.nH+ds.nL;
+
+    SampleIndex idx;
+    FileStamp s, hl;
+    if(!scan_index(ds, g2, job, idx, s, hl))
+        return false;
+
+    h.s_size = s.size;
+    h.s_mtime = s.mtime;
+    h.s_hash = s.hash;
+    h.hl_size = hl.size;
+    h.hl_mtime = hl.mtime;
+    h.hl_hash = hl.hash;
+    h.n_s = idx.s.size();
+    h.n_hl = idx.hl.size();
+
+    ofstream out;
+    if(!make_job_dir(ds, g2, job))
+        return false;
+    out.open(index_filename(ds, g2, job), ios::binary);
+    if(!out)
+        return false;
+
+    vector<int64_t> temp(idx.s.begin(), idx.s.end());
+    temp.insert(temp.end(), idx.hl.begin(), idx.hl.end());
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)temp.data(), temp.size()*sizeof(int64_t));
+    return (bool)out;
+}
+
+bool read_index(const Dataset& ds, double g2, int job, bool read_hl, SampleIndex& idx)
+{
+    // Compacted jobs have their offsets in the index of the coupling
+    ifstream in;
+    in.open(index_filename(ds, g2, job), ios::binary);
+    if(!in)
+        return compacted_index(ds, g2, job, read_hl, idx);
+
+    IndexHeader h;
+    if(!in.read((char*)&h, sizeof(h)))
+        return false;
+    if(memcmp(h.magic, "RFLI", 4) || h.format != INDEX_FORMAT || h.n_mat != ds.nH+ds.nL || h.n_s < 0 || h.n_hl < 0)
+        return false;
+    if(read_hl && h.hl_size < 0)
+        return false;
+
+    string filename = data_path(ds, g2, job);
+    FileStamp s, hl;
+    s.size = h.s_size;
+    s.mtime = h.s_mtime;
+    s.hash = h.s_hash;
+    hl.size = h.hl_size;
+    hl.mtime = h.hl_mtime;
+    hl.hash = h.hl_hash;
+    if(!file_matches(filename + "_S.txt", s) || (read_hl && !file_matches(filename + "_HL.txt", hl)))
+        return false;
+
+    vector<int64_t> temp(h.n_s + h.n_hl);
+    if(!in.read((char*)temp.data(), temp.size()*sizeof(int64_t)))
+        return false;
+    idx.s.assign(temp.begin(), temp.begin()+h.n_s);
+    if(read_hl)
+        idx.hl.assign(temp.begin()+h.n_s, temp.end());
+    else
+        idx.hl.clear();
+    return true;
+}
@@ -0,0 +1,559 @@
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <lzma.h>
+#include "parallel.hpp"
+#include "compact.hpp"
+#include "inflate.hpp"
+
+using namespace std;
+
+// Bytes decompressed at a time by the streaming decoders, and blocks
+// they may get ahead of the reader
+static const long long BLOCK_BYTES = 1 << 20;
+static const unsigned PIPE_DEPTH = 4;
+
+// bgzip members decompressed together by each thread
+static const int MEMBERS_PER_THREAD = 16;
+
+static bool exists(const string& filename)
+{
+    struct stat info;
+    return stat(filename.c_str(), &info) == 0;
+}
+
+static bool ends_with(const string& s, const string& end)
+{
+    return s.size() >= end.size() && s.compare(s.size()-end.size(), end.size(), end) == 0;
+}
+
+string stored_file(const string& filename)
+{
+    for(const auto& ext : {"", ".gz", ".xz"})
+        if(exists(filename + ext))
+            return filename + ext;
+    return filename;
+}
+
+// Uncompressed file, or the region of a shard holding a compacted one
+class PlainSource : public ByteSource
+{
+    private:
+        ifstream in;
+        long long base;
+        long long n;
+        long long pos;
+
+    public:
+        bool open(const string& filename, long long base_=0, long long n_=-1)
+        {
+            in.open(filename, ios::binary);
+            if(!in)
+                return false;
+            base = base_;
+            n = n_;
+            pos = 0;
+            if(n < 0)
+            {
+                in.seekg(0, ios::end);
+                n = (long long)in.tellg() - base;
+            }
+            in.seekg(base);
+            return (bool)in;
+        }
+
+        long long read(char* out, long long n_out)
+        {
+            in.read(out, max(0LL, min(n_out, n-pos)));
+            pos += in.gcount();
+            return in.gcount();
+        }
+
+        bool seek(long long off)
+        {
+            in.clear();
+            pos = off;
+            return (bool)in.seekg(base+off);
+        }
+
+        long long size() const { return n; }
+};
+
+// Decompress one whole gzip member of known uncompressed size
+static bool inflate_member(const unsigned char* p, long long n, char* out, long long n_out)
+{
+    char dummy;
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if(inflateInit2(&z, 15+16) != Z_OK)
+        return false;
+    z.next_in = (Bytef*)p;
+    z.avail_in = n;
+    z.next_out = (Bytef*)(n_out ? out : &dummy);
+    z.avail_out = n_out ? n_out : 1;
+    bool ok = inflate(&z, Z_FINISH) == Z_STREAM_END && (long long)z.total_out == n_out;
+    inflateEnd(&z);
+    return ok;
+}
+
+// bgzip file, with the compressed and uncompressed offset of every member
+class BgzfSource : public ByteSource
+{
+    private:
+        ifstream in;
+        vector<long long> coff;
+        vector<long long> uoff;
+        vector<unsigned char> comp;
+        vector<char> batch;
+        long long first;
+        long long last;
+        long long pos;
+        int n_thr;
+
+        // Decompress the batch of members starting with member m
+        bool decode(long long m)
+        {
+            long long n_members = coff.size()-1;
+            first = m;
+            last = min(n_members, m + (long long)MEMBERS_PER_THREAD*n_thr);
+            comp.resize(coff[last]-coff[first]);
+            batch.resize(uoff[last]-uoff[first]);
+            in.clear();
+            in.seekg(coff[first]);
+            if(!in.read((char*)comp.data(), comp.size()))
+            {
+                last = first;
+                return false;
+            }
+
+            vector<char> ok(last-first, 1);
+            parallel_for(0, last-first, [&](int k, int)
+            {
+                long long i = first+k;
+                ok[k] = inflate_member(comp.data() + (coff[i]-coff[first]), coff[i+1]-coff[i], batch.data() + (uoff[i]-uoff[first]), uoff[i+1]-uoff[i]);
+            }, n_thr);
+            if(find(ok.begin(), ok.end(), 0) != ok.end())
+            {
+                last = first;
+                return false;
+            }
+            return true;
+        }
+
+    public:
+        BgzfSource() : first(0), last(0), pos(0), n_thr(1) {}
+
+        // Walk the member headers, false if some member isn't a bgzip block
+        bool open(const string& filename)
+        {
+            in.open(filename, ios::binary);
+            if(!in)
+                return false;
+            in.seekg(0, ios::end);
+            long long file_size = in.tellg();
+
+            long long c = 0;
+            long long u = 0;
+            while(c < file_size)
+            {
+                // Fixed header, then the extra field with the BC subfield
+                unsigned char h[12];
+                in.seekg(c);
+                if(!in.read((char*)h, sizeof(h)) || h[0] != 31 || h[1] != 139 || h[2] != 8 || !(h[3] & 4))
+                    return false;
+                int xlen = h[10] | h[11] << 8;
+                vector<unsigned char> x(xlen);
+                if(!in.read((char*)x.data(), xlen))
+                    return false;
+                long long bsize = -1;
+                for(int k=0; k+4<=xlen; k+=4+(x[k+2] | x[k+3] << 8))
+                    if(x[k] == 'B' && x[k+1] == 'C' && (x[k+2] | x[k+3] << 8) == 2 && k+6 <= xlen)
+                        bsize = x[k+4] | x[k+5] << 8;
+                if(bsize < 0 || c+bsize+1 > file_size)
+                    return false;
+
+                // Uncompressed size in the last 4 bytes of the member
+                unsigned char isize[4];
+                in.seekg(c+bsize+1-4);
+                if(!in.read((char*)isize, 4))
+                    return false;
+                coff.push_back(c);
+                uoff.push_back(u);
+                c += bsize+1;
+                u += isize[0] | isize[1] << 8 | isize[2] << 16 | (long long)isize[3] << 24;
+            }
+            coff.push_back(c);
+            uoff.push_back(u);
+            return coff.size() > 1;
+        }
+
+        long long read(char* out, long long n)
+        {
+            long long got = 0;
+            while(got < n && pos < uoff.back())
+            {
+                if(last == first || pos < uoff[first] || pos >= uoff[last])
+                {
+                    long long m = upper_bound(uoff.begin(), uoff.end(), pos) - uoff.begin() - 1;
+                    if(!decode(m))
+                        return got ? got : -1;
+                }
+                long long k = min(n-got, uoff[last]-pos);
+                memcpy(out+got, batch.data() + (pos-uoff[first]), k);
+                got += k;
+                pos += k;
+            }
+            return got;
+        }
+
+        bool seek(long long off)
+        {
+            if(off < 0 || off > uoff.back())
+                return false;
+            pos = off;
+            return true;
+        }
+
+        long long size() const { return uoff.back(); }
+
+        void set_threads(int n) { n_thr = max(1, n); }
+};
+
+// Single stream decompressor that can start over
+class Decoder
+{
+    public:
+        virtual ~Decoder() {}
+
+        // Open the file and go to the beginning of the text
+        virtual bool open() = 0;
+
+        // Up to n bytes, fewer only at the end. Number of bytes, -1 on error
+        // (the bytes decoded before an error are returned first)
+        virtual long long next(char*, long long) = 0;
+};
+
+// gzip file of one or more members
+class GzipDecoder : public Decoder
+{
+    private:
+        string filename;
+        ifstream in;
+        vector<char> buf;
+        z_stream z;
+        bool init;
+        bool ended;
+        bool bad;
+
+    public:
+        GzipDecoder(const string& filename_) : filename(filename_), buf(1 << 16), init(false), ended(false), bad(false) {}
+
+        ~GzipDecoder()
+        {
+            if(init)
+                inflateEnd(&z);
+        }
+
+        bool open()
+        {
+            if(init)
+                inflateEnd(&z);
+            memset(&z, 0, sizeof(z));
+            init = inflateInit2(&z, 15+16) == Z_OK;
+            ended = false;
+            bad = false;
+            in.close();
+            in.clear();
+            in.open(filename, ios::binary);
+            return init && in;
+        }
+
+        long long next(char* out, long long n)
+        {
+            if(bad)
+                return -1;
+            z.next_out = (Bytef*)out;
+            z.avail_out = n;
+            while(z.avail_out > 0 && !bad)
+            {
+                if(z.avail_in == 0)
+                {
+                    in.read(buf.data(), buf.size());
+                    z.next_in = (Bytef*)buf.data();
+                    z.avail_in = in.gcount();
+                    if(z.avail_in == 0)
+                    {
+                        // A member cut short is an error
+                        bad = !ended;
+                        break;
+                    }
+                }
+
+                // Data after the end of a member is the next member
+                if(ended)
+                {
+                    inflateReset(&z);
+                    ended = false;
+                }
+                int r = inflate(&z, Z_NO_FLUSH);
+                if(r == Z_STREAM_END)
+                    ended = true;
+                else if(r != Z_OK && r != Z_BUF_ERROR)
+                    bad = true;
+            }
+            long long got = n - z.avail_out;
+            return got || !bad ? got : -1;
+        }
+};
+
+// xz file of one or more streams
+class XzDecoder : public Decoder
+{
+    private:
+        string filename;
+        ifstream in;
+        vector<char> buf;
+        lzma_stream s;
+        bool init;
+        bool in_done;
+        bool ended;
+        bool bad;
+
+    public:
+        XzDecoder(const string& filename_) : filename(filename_), buf(1 << 16), init(false), in_done(false), ended(false), bad(false) {}
+
+        ~XzDecoder()
+        {
+            if(init)
+                lzma_end(&s);
+        }
+
+        bool open()
+        {
+            if(init)
+                lzma_end(&s);
+            memset(&s, 0, sizeof(s));
+            init = lzma_stream_decoder(&s, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+            in_done = false;
+            ended = false;
+            bad = false;
+            in.close();
+            in.clear();
+            in.open(filename, ios::binary);
+            return init && in;
+        }
+
+        long long next(char* out, long long n)
+        {
+            if(bad)
+                return -1;
+            s.next_out = (uint8_t*)out;
+            s.avail_out = n;
+            while(s.avail_out > 0 && !ended && !bad)
+            {
+                if(s.avail_in == 0 && !in_done)
+                {
+                    in.read(buf.data(), buf.size());
+                    s.next_in = (const uint8_t*)buf.data();
+                    s.avail_in = in.gcount();
+                    in_done = s.avail_in == 0;
+                }
+                lzma_ret r = lzma_code(&s, in_done ? LZMA_FINISH : LZMA_RUN);
+                if(r == LZMA_STREAM_END)
+                    ended = true;
+                else if(r != LZMA_OK)
+                    bad = true;
+            }
+            long long got = n - s.avail_out;
+            return got || !bad ? got : -1;
+        }
+};
+
+// Text of a single stream, decompressed by a worker thread into a queue of blocks
+class PipeSource : public ByteSource
+{
+    private:
+        unique_ptr<Decoder> dec;
+        thread worker;
+        mutex mtx;
+        condition_variable has_data;
+        condition_variable has_space;
+        deque<vector<char>> queue;
+        bool done;
+        bool failed;
+        bool stop;
+        vector<char> cur;
+        size_t cur_pos;
+        long long pos;
+
+        void run()
+        {
+            while(true)
+            {
+                vector<char> block(BLOCK_BYTES);
+                long long n = dec->next(block.data(), block.size());
+
+                unique_lock<mutex> lock(mtx);
+                if(n <= 0)
+                {
+                    failed = n < 0;
+                    done = true;
+                    has_data.notify_one();
+                    return;
+                }
+                block.resize(n);
+                has_space.wait(lock, [&] { return stop || queue.size() < PIPE_DEPTH; });
+                if(stop)
+                    return;
+                queue.push_back(move(block));
+                has_data.notify_one();
+            }
+        }
+
+        void halt()
+        {
+            if(!worker.joinable())
+                return;
+            {
+                lock_guard<mutex> lock(mtx);
+                stop = true;
+            }
+            has_space.notify_one();
+            worker.join();
+        }
+
+        // Start decompressing from the beginning
+        bool start()
+        {
+            halt();
+            queue.clear();
+            cur.clear();
+            cur_pos = 0;
+            pos = 0;
+            done = failed = stop = false;
+
+            // No worker will ever signal, reads must see the failure at once
+            if(!dec->open())
+            {
+                done = failed = true;
+                return false;
+            }
+            worker = thread(&PipeSource::run, this);
+            return true;
+        }
+
+        // Next block of the queue, false at the end of the text
+        bool pull()
+        {
+            unique_lock<mutex> lock(mtx);
+            has_data.wait(lock, [&] { return !queue.empty() || done; });
+            if(queue.empty())
+                return false;
+            cur = move(queue.front());
+            queue.pop_front();
+            cur_pos = 0;
+            has_space.notify_one();
+            return true;
+        }
+
+    public:
+        PipeSource(Decoder* dec_) : dec(dec_), done(false), failed(false), stop(false), cur_pos(0), pos(0) {}
+
+        ~PipeSource()
+        {
+            halt();
+        }
+
+        bool open()
+        {
+            return start();
+        }
+
+        long long read(char* out, long long n)
+        {
+            long long got = 0;
+            while(got < n)
+            {
+                // An error is reported once the bytes before it are out
+                if(cur_pos == cur.size() && !pull())
+                {
+                    if(failed && !got)
+                        return -1;
+                    break;
+                }
+                long long k = min(n-got, (long long)(cur.size()-cur_pos));
+                memcpy(out+got, cur.data()+cur_pos, k);
+                cur_pos += k;
+                got += k;
+            }
+            pos += got;
+            return got;
+        }
+
+        // Forward by skipping blocks, backwards by starting over
+        bool seek(long long off)
+        {
+            if(off < 0 || (off < pos && !start()))
+                return false;
+            while(pos < off)
+            {
+                if(cur_pos == cur.size() && !pull())
+                    return false;
+                long long k = min(off-pos, (long long)(cur.size()-cur_pos));
+                cur_pos += k;
+                pos += k;
+            }
+            return true;
+        }
+
+        long long size() const { return -1; }
+
+        bool random_access() const { return false; }
+};
+
+unique_ptr<ByteSource> open_source(const string& filename)
+{
+    string name = stored_file(filename);
+    if(ends_with(name, ".gz"))
+    {
+        unique_ptr<BgzfSource> bgzf(new BgzfSource);
+        if(bgzf->open(name))
+            return bgzf;
+
+        unique_ptr<PipeSource> pipe(new PipeSource(new GzipDecoder(name)));
+        if(pipe->open())
+            return pipe;
+        return nullptr;
+    }
+
+    if(ends_with(name, ".xz"))
+    {
+        unique_ptr<PipeSource> pipe(new PipeSource(new XzDecoder(name)));
+        if(pipe->open())
+            return pipe;
+        return nullptr;
+    }
+
+    // Neither the file nor a compressed version, maybe it was compacted
+    unique_ptr<PlainSource> plain(new PlainSource);
+    CompactEntry e;
+    if(!exists(name) && find_compacted(filename, e))
+    {
+        if(plain->open(e.shard, e.offset, e.size))
+            return plain;
+        return nullptr;
+    }
+
+    if(plain->open(name))
+        return plain;
+    return nullptr;
+}
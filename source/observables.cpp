@@ -0,0 +1,115 @@
+#include <armadillo>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "sample.hpp"
+#include "observables.hpp"
+
+using namespace std;
+using namespace arma;
+
+
+// Action per sample, g2*S2 + S4. S.cpp reports nH times this (it adds
+// the action once per H matrix), so compare with S.cpp divided by nH
+static double obs_S(const Sample& smp, double g2)
+{
+    return g2*smp.S2 + smp.S4;
+}
+
+// Quadratic part of the action
+static double obs_S2(const Sample& smp, double)
+{
+    return smp.S2;
+}
+
+// Quartic part of the action
+static double obs_S4(const Sample& smp, double)
+{
+    return smp.S4;
+}
+
+// Equipartition check (dofs.cpp)
+static double obs_dofs(const Sample& smp, double g2)
+{
+    return 2*g2*smp.S2 + 4*smp.S4;
+}
+
+// Order parameter normalized by tr H^2 (F.cpp)
+static double obs_F(const Sample& smp, double)
+{
+    double temp = 0;
+    double norm = 0;
+    for(int k=0; k<smp.nH; ++k)
+    {
+        temp += pow(trace(smp.mat[k]).real(), 2);
+        norm += trace(smp.mat[k]*smp.mat[k]).real();
+    }
+    return temp/(smp.dim*norm);
+}
+
+// Order parameter normalized by dim^2 (F_new.cpp)
+static double obs_F_new(const Sample& smp, double)
+{
+    double temp = 0;
+    for(int k=0; k<smp.nH; ++k)
+        temp += pow(trace(smp.mat[k]).real(), 2);
+    return temp/(smp.dim*smp.dim);
+}
+
+// Sum of tr H^2 over the H matrices
+static double obs_trH2(const Sample& smp, double)
+{
+    double temp = 0;
+    for(int k=0; k<smp.nH; ++k)
+        temp += trace(smp.mat[k]*smp.mat[k]).real();
+    return temp;
+}
+
+// Squared modulus of the normalized trace of W = H1 + iH2, (2,0) geometry (r2.cpp).
+// It reads matrices 0 and 1, which are both H only in that geometry
+static double obs_r2(const Sample& smp, double)
+{
+    cx_double trW = trace(smp.mat[0]) + cx_double(0.,1.)*trace(smp.mat[1]);
+    double rho = abs(trW)/smp.dim;
+    return rho*rho;
+}
+
+const vector<Observable>& observables()
+{
+    static const vector<Observable> list = 
+    {
+        {"S", obs_S, false, 1, USE_ACTION},
+        {"S2", obs_S2, false, 1, USE_ACTION},
+        {"S4", obs_S4, false, 1, USE_ACTION},
+        {"dofs", obs_dofs, false, 1, USE_ACTION},
+        {"F", obs_F, true, 1, USE_H},
+        {"F_new", obs_F_new, true, 1, USE_H},
+        {"trH2", obs_trH2, true, 1, USE_H},
+        {"r2", obs_r2, true, 1, USE_H | USE_L}
+    };
+    return list;
+}
+
+const Observable* find_observable(const string& name)
+{
+    for(const auto& obs : observables())
+    {
+        if(obs.name == name)
+            return &obs;
+    }
+    return nullptr;
+}
+
+Projection projection(const Dataset& ds, const vector<const Observable*>& obs_vec)
+{
+    int uses = 0;
+    for(const auto& obs : obs_vec)
+        uses |= obs->uses;
+
+    Projection proj;
+    proj.action = uses & USE_ACTION;
+    for(int i=0; i<ds.nH+ds.nL; ++i)
+        if(uses & (i < ds.nH ? USE_H : USE_L))
+            proj.mats.push_back(i);
+    return proj;
+}
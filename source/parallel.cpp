@@ -0,0 +1,61 @@
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+#include <string>
+#include "parallel.hpp"
+
+using namespace std;
+
+
+int n_threads()
+{
+    // Environment variable takes precedence
+    const char* env = getenv("RFL_THREADS");
+    if(env)
+    {
+        int n = atoi(env);
+        if(n > 0)
+            return n;
+    }
+
+    // Fall back to the number of cores
+    int n = thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+void parallel_for(int begin, int end, const function<void(int, int)>& f, int n_thr)
+{
+    // Nothing to do
+    if(end <= begin)
+        return;
+
+    // Never spawn more threads than iterations
+    if(n_thr > end-begin)
+        n_thr = end-begin;
+
+    // Serial fallback
+    if(n_thr < 2)
+    {
+        for(int i=begin; i<end; ++i)
+            f(i, 0);
+        return;
+    }
+
+    // Iterations are handed out one at a time, so that expensive
+    // iterations (e.g. large job files) do not stall a whole chunk
+    atomic<int> next(begin);
+    vector<thread> pool;
+    for(int t=0; t<n_thr; ++t)
+    {
+        pool.push_back(thread([&, t]()
+        {
+            int i;
+            while((i = next++) < end)
+                f(i, t);
+        }));
+    }
+
+    for(auto& th : pool)
+        th.join();
+}
@@ -0,0 +1,211 @@
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+#include "parse.hpp"
+
+using namespace std;
+
+// Longest number that is guaranteed to be parsed out of the buffer in one piece
+static const size_t MAX_TOKEN = 128;
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+bool parse_double(const char*& p, double& x)
+{
+    const char* start = p;
+    const char* q = p;
+
+    bool neg = false;
+    if(*q == '-' || *q == '+')
+        neg = *q++ == '-';
+
+    // Up to 19 digits fit in the mantissa (leading zeros included,
+    // longer numbers take the slow path)
+    uint64_t m = 0;
+    const char* d = q;
+    for(; (unsigned)(*q - '0') < 10; ++q)
+        m = 10*m + (*q - '0');
+    int n_read = q-d;
+    int exp10 = 0;
+    if(*q == '.')
+    {
+        d = ++q;
+        for(; (unsigned)(*q - '0') < 10; ++q)
+            m = 10*m + (*q - '0');
+        exp10 = d-q;
+        n_read -= exp10;
+    }
+    if(n_read && (*q == 'e' || *q == 'E'))
+    {
+        const char* e = q+1;
+        bool e_neg = false;
+        if(*e == '-' || *e == '+')
+            e_neg = *e++ == '-';
+        if((unsigned)(*e - '0') < 10)
+        {
+            int n = 0;
+            for(; (unsigned)(*e - '0') < 10; ++e)
+                if(n < 10000)
+                    n = 10*n + (*e - '0');
+            exp10 += e_neg ? -n : n;
+            q = e;
+        }
+    }
+
+    bool fast = n_read && n_read <= 19;
+    if(fast && m == 0)
+    {
+        x = neg ? -0. : 0.;
+        p = q;
+        return true;
+    }
+
+#if LDBL_MANT_DIG == 64 && (defined(__x86_64__) || defined(__i386__))
+    // m and 10^k (k <= 27) are exact in extended precision, so m*10^k and
+    // m/10^k are rounded once. Rounding that again to double is only off
+    // when the first rounding lands on a midpoint between two doubles
+    static const long double pow10[] = {1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+        1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+        1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L};
+    if(fast && exp10 >= -27 && exp10 <= 27)
+    {
+        long double r = exp10 < 0 ? (long double)m / pow10[-exp10] : (long double)m * pow10[exp10];
+        uint64_t sig;
+        memcpy(&sig, &r, sizeof(sig));
+        if((sig & 0x7ff) != 0x400)
+        {
+            x = neg ? -(double)r : (double)r;
+            p = q;
+            return true;
+        }
+    }
+#else
+    // Exact operands and a single rounding
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if(fast && m <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+    {
+        double r = exp10 < 0 ? (double)m / pow10[-exp10] : (double)m * pow10[exp10];
+        x = neg ? -r : r;
+        p = q;
+        return true;
+    }
+#endif
+
+    // Long mantissas, large exponents, inf and nan
+    char* stop;
+    x = strtod(start, &stop);
+    if(stop == start)
+        return false;
+    p = stop;
+    return true;
+}
+
+TextReader::TextReader(size_t buf_size_)
+    : buf(1, '\0'), buf_size(buf_size_), pos(0), end(0), offset(0), at_eof(true)
+{
+}
+
+bool TextReader::open(const string& filename)
+{
+    in = open_source(filename);
+    pos = end = 0;
+    offset = 0;
+    at_eof = !in;
+    buf.assign(1, '\0');
+    if(!in)
+        return false;
+
+    // Small files get a buffer of their size
+    long long size = in->size();
+    buf.resize((size < 0 ? buf_size : min((size_t)size, buf_size))+MAX_TOKEN+1);
+    return true;
+}
+
+void TextReader::refill()
+{
+    // Keep the unread tail in front of the new block
+    size_t rest = end-pos;
+    memmove(buf.data(), buf.data()+pos, rest);
+    offset += pos;
+    pos = 0;
+    end = rest;
+
+    // A short read is the end of the file (or an error)
+    long long want = buf.size()-1-end;
+    long long got = in->read(buf.data()+end, want);
+    if(got < want)
+        at_eof = true;
+    end += max(got, 0LL);
+
+    // Sentinel that stops the parser
+    buf[end] = '\0';
+}
+
+bool TextReader::read(double& x)
+{
+    // The number has to be whole in the buffer
+    while(true)
+    {
+        while(pos < end && is_space(buf[pos]))
+            ++pos;
+        if(at_eof || end-pos >= MAX_TOKEN)
+            break;
+        refill();
+    }
+    if(pos == end)
+        return false;
+
+    const char* p = buf.data()+pos;
+    if(!parse_double(p, x))
+        return false;
+    pos = p-buf.data();
+    return true;
+}
+
+bool TextReader::skip_lines(long long n)
+{
+    while(n > 0)
+    {
+        const char* nl = (const char*)memchr(buf.data()+pos, '\n', end-pos);
+        if(nl)
+        {
+            pos = nl-buf.data()+1;
+            --n;
+        }
+        else if(!at_eof)
+            refill();
+        else
+        {
+            if(pos < end)
+                --n;
+            pos = end;
+            break;
+        }
+    }
+    return n == 0;
+}
+
+bool TextReader::seek(long long off)
+{
+    // Short jumps forward (decimated samples) stay in the buffer
+    if(off >= offset+(long long)pos && off <= offset+(long long)end)
+    {
+        pos = off-offset;
+        return true;
+    }
+
+    pos = end = 0;
+    offset = off;
+    at_eof = !in || !in->seek(off);
+    buf[0] = '\0';
+    return !at_eof;
+}
@@ -0,0 +1,157 @@
+#include <armadillo>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "reduce.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Terms summed sequentially at the bottom of the pairwise tree
+static const int LEAF = 8;
+
+// Independent lanes of the compensated sum
+static const int LANES = 4;
+
+int sum_mode()
+{
+    // Compensated by default when the matrices are read in single precision
+    const char* env = getenv("RFL_SUM");
+    const char* prec = getenv("RFL_PRECISION");
+    if(!env)
+        return prec && !strcmp(prec, "single") ? SUM_NEUMAIER : SUM_PLAIN;
+    if(!strcmp(env, "pairwise"))
+        return SUM_PAIRWISE;
+    if(!strcmp(env, "neumaier"))
+        return SUM_NEUMAIER;
+    return SUM_PLAIN;
+}
+
+// One step of Neumaier's compensated summation
+static inline void neumaier_add(double& s, double& c, double x)
+{
+    double t = s + x;
+    c += (std::abs(s) >= std::abs(x)) ? (s - t) + x : (x - t) + s;
+    s = t;
+}
+
+SumAccumulator::SumAccumulator(int mode_)
+    : mode(mode_), s(0), n(0), lane_s(LANES, 0.), lane_c(LANES, 0.)
+{
+}
+
+void SumAccumulator::add(double x)
+{
+    switch(mode)
+    {
+        case SUM_PAIRWISE:
+        {
+            leaf.push_back(x);
+            if((int)leaf.size() < LEAF)
+                break;
+
+            // A complete leaf is merged with its completed siblings, like
+            // the carries of a binary counter of the number of leaves
+            double v = 0;
+            for(const auto& y : leaf)
+                v += y;
+            leaf.clear();
+            long n_leaf = n/LEAF + 1;
+            for(; n_leaf%2 == 0; n_leaf /= 2)
+            {
+                v = partial.back() + v;
+                partial.pop_back();
+            }
+            partial.push_back(v);
+            break;
+        }
+
+        case SUM_NEUMAIER:
+            neumaier_add(lane_s[n%LANES], lane_c[n%LANES], x);
+            break;
+
+        default:
+            s += x;
+    }
+    ++n;
+}
+
+double SumAccumulator::result() const
+{
+    switch(mode)
+    {
+        case SUM_PAIRWISE:
+        {
+            // Incomplete leaf first, then subtrees from the smallest up
+            double v = 0;
+            for(const auto& y : leaf)
+                v += y;
+            for(auto it=partial.rbegin(); it!=partial.rend(); ++it)
+                v = *it + v;
+            return v;
+        }
+
+        case SUM_NEUMAIER:
+        {
+            double sum = 0, comp = 0;
+            for(int l=0; l<LANES; ++l)
+            {
+                neumaier_add(sum, comp, lane_s[l]);
+                neumaier_add(sum, comp, lane_c[l]);
+            }
+            return sum + comp;
+        }
+
+        default:
+            return s;
+    }
+}
+
+double pairwise_sum(const double* x, int n)
+{
+    SumAccumulator acc(SUM_PAIRWISE);
+    for(int i=0; i<n; ++i)
+        acc.add(x[i]);
+    return acc.result();
+}
+
+double neumaier_sum(const double* x, int n)
+{
+    // Lanes are independent, so that the loop can be vectorized
+    double s[LANES] = {0}, c[LANES] = {0};
+    int n_full = n - n%LANES;
+    for(int i=0; i<n_full; i+=LANES)
+        for(int l=0; l<LANES; ++l)
+            neumaier_add(s[l], c[l], x[i+l]);
+    for(int i=n_full; i<n; ++i)
+        neumaier_add(s[i-n_full], c[i-n_full], x[i]);
+
+    double sum = 0, comp = 0;
+    for(int l=0; l<LANES; ++l)
+    {
+        neumaier_add(sum, comp, s[l]);
+        neumaier_add(sum, comp, c[l]);
+    }
+    return sum + comp;
+}
+
+double reduce_sum(const vec& x, int mode)
+{
+    switch(mode)
+    {
+        case SUM_PAIRWISE:
+            return pairwise_sum(x.memptr(), x.n_elem);
+        case SUM_NEUMAIER:
+            return neumaier_sum(x.memptr(), x.n_elem);
+        default:
+            return accu(x);
+    }
+}
+
+double reduce_mean(const vec& x, int mode)
+{
+    if(mode == SUM_PLAIN)
+        return mean(x);
+    return reduce_sum(x, mode)/x.n_elem;
+}
@@ -0,0 +1,425 @@
+#include <armadillo>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include "dataset.hpp"
+#include "sample.hpp"
+#include "observables.hpp"
+#include "parallel.hpp"
+#include "store.hpp"
+#include "reweight.hpp"
+
+using namespace std;
+using namespace arma;
+
+
+double log_sum_exp(const vec& x)
+{
+    if(x.n_elem == 0)
+        return -numeric_limits<double>::infinity();
+
+    double m = max(x);
+    if(std::isinf(m))
+        return m;
+
+    double s = 0;
+    for(unsigned i=0; i<x.n_elem; ++i)
+        s += exp(x(i)-m);
+    return m + log(s);
+}
+
+bool load_rw_jobs(const Dataset& ds, double g2, const Observable& obs, vector<RwJob>& jobs)
+{
+    jobs.assign(ds.job_vec.size(), RwJob());
+    vector<char> ok(ds.job_vec.size(), 1);
+
+    // The action components are always needed
+    Projection proj = projection(ds, {&obs});
+    proj.action = true;
+
+    // Threads left over when there are fewer jobs than threads parse chunks of each file
+    int n_inner = max(1, n_threads()/(int)ds.job_vec.size());
+    parallel_for(0, ds.job_vec.size(), [&](int i, int)
+    {
+        RwJob& job = jobs[i];
+
+        // Values written by multi_obs to the columnar store, if up to date
+        if(read_column(ds, g2, ds.job_vec[i], *find_observable("S2"), job.S2) && read_column(ds, g2, ds.job_vec[i], *find_observable("S4"), job.S4))
+        {
+            if(obs.need_hl && read_column(ds, g2, ds.job_vec[i], obs, job.obs) && job.obs.n_elem == job.S2.n_elem)
+                return;
+
+            if(!obs.need_hl && job.S4.n_elem == job.S2.n_elem)
+            {
+                Sample smp;
+                job.obs.set_size(job.S2.n_elem);
+                for(unsigned j=0; j<job.S2.n_elem; ++j)
+                {
+                    smp.S2 = job.S2(j);
+                    smp.S4 = job.S4(j);
+                    job.obs(j) = obs.f(smp, g2);
+                }
+                return;
+            }
+        }
+
+        ChunkedReader reader(ds, g2, ds.job_vec[i], proj, n_inner);
+        if(!reader.is_open())
+        {
+            ok[i] = 0;
+            return;
+        }
+
+        job.S2.set_size(reader.size());
+        job.S4.set_size(reader.size());
+        job.obs.set_size(reader.size());
+
+        Sample smp(ds);
+        for(int j=0; j<reader.size(); ++j)
+        {
+            if(!reader.read(smp))
+            {
+                ok[i] = 0;
+                return;
+            }
+            job.S2(j) = smp.S2;
+            job.S4(j) = smp.S4;
+            job.obs(j) = obs.f(smp, g2);
+        }
+    });
+
+    for(unsigned i=0; i<ok.size(); ++i)
+    {
+        if(!ok[i])
+        {
+            cerr << "Error: couldn't read job " << ds.job_vec[i] << " at g2 " << g2 << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void reweight_sums(const vector<RwJob>& jobs, double g2, double g2p, const Observable& obs, mat& sums)
+{
+    double dg2 = g2p - g2;
+
+    // Largest log-weight over all jobs, so that the biggest weight is 1
+    double shift = -numeric_limits<double>::infinity();
+    for(const auto& job : jobs)
+        for(unsigned j=0; j<job.S2.n_elem; ++j)
+            shift = std::max(shift, -dg2*job.S2(j));
+
+    // Observables that only depend on the action are evaluated at g2p,
+    // the others do not depend on the coupling
+    Sample smp;
+
+    sums.zeros(jobs.size(), RW_NCOMP);
+    for(unsigned i=0; i<jobs.size(); ++i)
+    {
+        const RwJob& job = jobs[i];
+        for(unsigned j=0; j<job.S2.n_elem; ++j)
+        {
+            double w = exp(-dg2*job.S2(j) - shift);
+            double O = job.obs(j);
+            if(!obs.need_hl)
+            {
+                smp.S2 = job.S2(j);
+                smp.S4 = job.S4(j);
+                O = obs.f(smp, g2p);
+            }
+
+            sums(i, RW_W) += w;
+            sums(i, RW_WO) += w*O;
+            sums(i, RW_WO2) += w*O*O;
+            sums(i, RW_WO4) += w*O*O*O*O;
+            sums(i, RW_W2) += w*w;
+        }
+    }
+}
+
+double rw_mean(const rowvec& s)
+{
+    return s(RW_WO)/s(RW_W);
+}
+
+double rw_sus(const rowvec& s)
+{
+    double avg = s(RW_WO)/s(RW_W);
+    return s(RW_WO2)/s(RW_W) - avg*avg;
+}
+
+double rw_ess(const rowvec& s)
+{
+    return s(RW_W)*s(RW_W)/s(RW_W2);
+}
+
+double rw_binder(const rowvec& s)
+{
+    double m2 = s(RW_WO2)/s(RW_W);
+    double m4 = s(RW_WO4)/s(RW_W);
+    return 1. - m4/(3.*m2*m2);
+}
+
+double rw_binder_sq(const rowvec& s)
+{
+    double m2 = s(RW_WO)/s(RW_W);
+    double m4 = s(RW_WO2)/s(RW_W);
+    return 1. - m4/(3.*m2*m2);
+}
+
+bool load_wham_data(const Dataset& ds, const Observable& obs, WhamData& data)
+{
+    data.g2 = ds.g2_vec;
+    data.n_jobs = ds.job_vec.size();
+
+    // Read one g2 point at a time, then copy into the flat arrays
+    vector<vector<RwJob>> runs(ds.g2_vec.size());
+    unsigned n_tot = 0;
+    for(unsigned a=0; a<ds.g2_vec.size(); ++a)
+    {
+        clog << "g2: " << ds.g2_vec[a] << endl;
+        if(!load_rw_jobs(ds, ds.g2_vec[a], obs, runs[a]))
+            return false;
+        for(const auto& job : runs[a])
+            n_tot += job.S2.n_elem;
+    }
+
+    data.S2.set_size(n_tot);
+    data.S4.set_size(n_tot);
+    data.obs.set_size(n_tot);
+    data.run.set_size(n_tot);
+    data.job.set_size(n_tot);
+
+    unsigned n = 0;
+    for(unsigned a=0; a<runs.size(); ++a)
+    {
+        for(unsigned i=0; i<runs[a].size(); ++i)
+        {
+            const RwJob& job = runs[a][i];
+            for(unsigned j=0; j<job.S2.n_elem; ++j)
+            {
+                data.S2(n) = job.S2(j);
+                data.S4(n) = job.S4(j);
+                data.obs(n) = job.obs(j);
+                data.run(n) = a;
+                data.job(n) = i;
+                ++n;
+            }
+        }
+        runs[a].clear();
+    }
+
+    return true;
+}
+
+// Samples are split in a fixed number of chunks, independent of the number
+// of threads, and partial results are combined in chunk order: this keeps
+// the free energies bitwise identical whatever the thread count
+static const int WHAM_CHUNKS = 256;
+
+// Log of the denominator sum_c N_c exp(f_c - g2_c*S2) for every sample
+static void wham_denominators(const WhamData& data, const vec& log_N, const vec& f, int skip, vec& log_den)
+{
+    int K = data.g2.size();
+    int N = data.S2.n_elem;
+
+    parallel_for(0, WHAM_CHUNKS, [&](int c, int)
+    {
+        int begin = (long)N*c/WHAM_CHUNKS;
+        int end = (long)N*(c+1)/WHAM_CHUNKS;
+        for(int i=begin; i<end; ++i)
+        {
+            if((int)data.job(i) == skip)
+                continue;
+
+            double m = -numeric_limits<double>::infinity();
+            for(int b=0; b<K; ++b)
+                m = std::max(m, log_N(b) + f(b) - data.g2[b]*data.S2(i));
+            
+            double s = 0;
+            for(int b=0; b<K; ++b)
+                s += exp(log_N(b) + f(b) - data.g2[b]*data.S2(i) - m);
+            log_den(i) = m + log(s);
+        }
+    });
+}
+
+// One self-consistency step f -> f_new
+static void wham_step(const WhamData& data, const vec& log_N, const vec& f, int skip, vec& log_den, vec& f_new)
+{
+    int K = data.g2.size();
+    int N = data.S2.n_elem;
+
+    wham_denominators(data, log_N, f, skip, log_den);
+
+    // Partial log-sum-exp of each chunk, stored as (max, sum)
+    mat part_max(WHAM_CHUNKS, K);
+    mat part_sum(WHAM_CHUNKS, K);
+    parallel_for(0, WHAM_CHUNKS, [&](int c, int)
+    {
+        int begin = (long)N*c/WHAM_CHUNKS;
+        int end = (long)N*(c+1)/WHAM_CHUNKS;
+        for(int b=0; b<K; ++b)
+        {
+            double m = -numeric_limits<double>::infinity();
+            for(int i=begin; i<end; ++i)
+                if((int)data.job(i) != skip)
+                    m = std::max(m, -data.g2[b]*data.S2(i) - log_den(i));
+
+            double s = 0;
+            if(!std::isinf(m))
+                for(int i=begin; i<end; ++i)
+                    if((int)data.job(i) != skip)
+                        s += exp(-data.g2[b]*data.S2(i) - log_den(i) - m);
+
+            part_max(c,b) = m;
+            part_sum(c,b) = s;
+        }
+    });
+
+    // Combine chunks in order
+    f_new.set_size(K);
+    for(int b=0; b<K; ++b)
+    {
+        double m = -numeric_limits<double>::infinity();
+        for(int c=0; c<WHAM_CHUNKS; ++c)
+            m = std::max(m, part_max(c,b));
+
+        double s = 0;
+        for(int c=0; c<WHAM_CHUNKS; ++c)
+            if(!std::isinf(part_max(c,b)))
+                s += part_sum(c,b)*exp(part_max(c,b) - m);
+        f_new(b) = -(m + log(s));
+    }
+
+    // Fix the arbitrary additive constant
+    double f0 = f_new(0);
+    for(int b=0; b<K; ++b)
+        f_new(b) -= f0;
+}
+
+int wham_solve(const WhamData& data, vec& f, int skip, double tol, int max_iter)
+{
+    int K = data.g2.size();
+
+    // Number of samples of each g2 point
+    vec log_N(K, fill::zeros);
+    for(unsigned i=0; i<data.S2.n_elem; ++i)
+        if((int)data.job(i) != skip)
+            log_N(data.run(i)) += 1;
+    for(int b=0; b<K; ++b)
+        log_N(b) = log(log_N(b));
+
+    if(f.n_elem != (unsigned)K)
+        f.zeros(K);
+
+    vec log_den(data.S2.n_elem);
+    vec f1, f2, f3;
+
+    // Fixed-point iteration accelerated with SQUAREM (Varadhan & Roland),
+    // each cycle costs three evaluations of the self-consistency map
+    int iter = 0;
+    while(iter < max_iter)
+    {
+        wham_step(data, log_N, f, skip, log_den, f1);
+        wham_step(data, log_N, f1, skip, log_den, f2);
+        iter += 2;
+
+        double norm_r = 0, norm_v = 0;
+        for(int b=0; b<K; ++b)
+        {
+            double r = f1(b) - f(b);
+            double v = f2(b) - 2*f1(b) + f(b);
+            norm_r += r*r;
+            norm_v += v*v;
+        }
+
+        // Already converged (or exactly linear)
+        if(norm_v == 0)
+        {
+            f = f2;
+            return iter;
+        }
+
+        // Extrapolation step, alpha <= -1 always improves on plain iteration
+        double alpha = -sqrt(norm_r/norm_v);
+        if(alpha > -1)
+            alpha = -1;
+
+        vec f_ext(K);
+        for(int b=0; b<K; ++b)
+        {
+            double r = f1(b) - f(b);
+            double v = f2(b) - 2*f1(b) + f(b);
+            f_ext(b) = f(b) - 2*alpha*r + alpha*alpha*v;
+        }
+
+        // Stabilize the extrapolated point with one plain step
+        wham_step(data, log_N, f_ext, skip, log_den, f3);
+        ++iter;
+
+        bool finite = true;
+        for(int b=0; b<K; ++b)
+            finite = finite && std::isfinite(f3(b));
+        if(!finite)
+            f3 = f2;
+
+        double delta = 0;
+        for(int b=0; b<K; ++b)
+            delta = std::max(delta, std::abs(f3(b) - f(b)));
+
+        f = f3;
+        if(delta < tol)
+            return iter;
+    }
+
+    return -1;
+}
+
+void wham_sums(const WhamData& data, const vec& f, double g2p, const Observable& obs, mat& sums, int skip)
+{
+    int K = data.g2.size();
+    int N = data.S2.n_elem;
+
+    vec log_N(K, fill::zeros);
+    for(int i=0; i<N; ++i)
+        if((int)data.job(i) != skip)
+            log_N(data.run(i)) += 1;
+    for(int b=0; b<K; ++b)
+        log_N(b) = log(log_N(b));
+
+    vec log_den(N);
+    wham_denominators(data, log_N, f, skip, log_den);
+
+    // Log-weights at g2p, shifted so that the largest weight is 1
+    double shift = -numeric_limits<double>::infinity();
+    for(int i=0; i<N; ++i)
+        if((int)data.job(i) != skip)
+            shift = std::max(shift, -g2p*data.S2(i) - log_den(i));
+
+    Sample smp;
+
+    sums.zeros(data.n_jobs, RW_NCOMP);
+    for(int i=0; i<N; ++i)
+    {
+        if((int)data.job(i) == skip)
+            continue;
+
+        double w = exp(-g2p*data.S2(i) - log_den(i) - shift);
+        double O = data.obs(i);
+        if(!obs.need_hl)
+        {
+            smp.S2 = data.S2(i);
+            smp.S4 = data.S4(i);
+            O = obs.f(smp, g2p);
+        }
+
+        int j = data.job(i);
+        sums(j, RW_W) += w;
+        sums(j, RW_WO) += w*O;
+        sums(j, RW_WO2) += w*O*O;
+        sums(j, RW_WO4) += w*O*O*O*O;
+        sums(j, RW_W2) += w*w;
+    }
+}
@@ -0,0 +1,384 @@
+#include <armadillo>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "dataset.hpp"
+#include "parse.hpp"
+#include "parallel.hpp"
+#include "sample.hpp"
+#include "index.hpp"
+#include "binary.hpp"
+#include "compress.hpp"
+
+using namespace std;
+using namespace arma;
+
+
+Sample::Sample(const Dataset& ds)
+    : S2(0), S4(0), dim(ds.sm.dim), nH(ds.nH), nL(ds.nL), mat(ds.nH+ds.nL, cx_mat(ds.sm.dim, ds.sm.dim))
+{
+}
+
+bool single_precision()
+{
+    const char* env = getenv("RFL_PRECISION");
+    return env && !strcmp(env, "single");
+}
+
+Projection full_projection(const Dataset& ds, bool read_hl)
+{
+    Projection proj;
+    if(read_hl)
+        for(int i=0; i<ds.nH+ds.nL; ++i)
+            proj.mats.push_back(i);
+    return proj;
+}
+
+void SampleReader::open_text(const Dataset& ds, double g2, int job)
+{
+    // Matrices out of the projection are skipped a line at a time
+    want.assign(n_mat, 0);
+    for(const auto& i : proj.mats)
+        if(i >= 0 && i < n_mat)
+            want[i] = 1;
+    read_hl = !proj.mats.empty();
+
+    string filename = data_path(ds, g2, job);
+    in_s.open(filename + "_S.txt");
+    if(read_hl)
+        in_hl.open(filename + "_HL.txt");
+}
+
+SampleReader::SampleReader(const Dataset& ds, double g2, int job, const Projection& proj_)
+    : proj(proj_), read_hl(false), mid_line(false), n_read(0), n_mat(ds.nH+ds.nL), indexed(false)
+{
+    JobView view = job_view(ds, g2, job);
+    n_samples = view.size;
+    first = view.first;
+    stride = view.stride;
+
+    // The binary copy needs no parsing and no scan of the burn-in
+    for(int single=proj.single; single>=0; --single)
+    {
+        unique_ptr<BinaryReader> b(new BinaryReader);
+        if(b->open(ds, g2, job, proj, single) && b->size() >= ds.sm.samples && b->seek(first))
+        {
+            bin = move(b);
+            return;
+        }
+    }
+
+    unique_ptr<CompressedReader> z(new CompressedReader);
+    if(z->open(ds, g2, job, proj) && z->size() >= ds.sm.samples && z->seek(first))
+    {
+        zip = move(z);
+        return;
+    }
+
+    open_text(ds, g2, job);
+
+    // Thermalization samples are skipped without being parsed, by a seek
+    // if the job has an index, otherwise by a scan (each matrix is written
+    // on its own line)
+    SampleIndex full;
+    int n_full = ds.sm.samples;
+    if(read_index(ds, g2, job, read_hl, full) && (int)full.s.size() >= n_full && (!read_hl || (int)full.hl.size() >= n_full))
+    {
+        known.s.resize(n_samples);
+        known.hl.resize(read_hl ? n_samples : 0);
+        for(int k=0; k<n_samples; ++k)
+        {
+            known.s[k] = full.s[first + (long long)k*stride];
+            if(read_hl)
+                known.hl[k] = full.hl[first + (long long)k*stride];
+        }
+        indexed = true;
+    }
+
+    if(indexed && n_samples > 0)
+        seek(known, 0);
+    else if(!indexed)
+    {
+        in_s.skip_lines(first);
+        if(read_hl)
+            in_hl.skip_lines((long long)first*n_mat);
+    }
+}
+
+SampleReader::SampleReader(const Dataset& ds, double g2, int job, bool read_hl_)
+    : SampleReader(ds, g2, job, full_projection(ds, read_hl_))
+{
+}
+
+SampleReader::SampleReader(const Dataset& ds, double g2, int job, const SampleIndex& idx, const Projection& proj_)
+    : proj(proj_), read_hl(false), mid_line(false), n_samples(idx.s.size()), n_read(0), n_mat(ds.nH+ds.nL),
+      first(0), stride(job_view(ds, g2, job).stride), known(idx), indexed(true)
+{
+    open_text(ds, g2, job);
+    if(n_samples > 0)
+        seek(idx, 0);
+}
+
+SampleReader::~SampleReader()
+{
+}
+
+void SampleReader::set_threads(int n_thr)
+{
+    if(zip)
+        zip->set_threads(n_thr);
+    in_s.set_threads(n_thr);
+    in_hl.set_threads(n_thr);
+}
+
+bool SampleReader::random_access() const
+{
+    return bin || zip || (in_s.random_access() && in_hl.random_access());
+}
+
+bool SampleReader::is_open() const
+{
+    return bin || zip || (in_s.is_open() && (!read_hl || in_hl.is_open()));
+}
+
+bool SampleReader::read(Sample& smp)
+{
+    if(n_read == n_samples)
+        return false;
+
+    if(bin || zip)
+    {
+        long long j = first + (long long)n_read*stride;
+        if(stride > 1 && !(bin ? bin->seek(j) : zip->seek(j)))
+            return false;
+        if(!(bin ? bin->read(smp) : zip->read(smp)))
+            return false;
+        ++n_read;
+        return true;
+    }
+
+    // Samples between two of the view: a seek through the index, otherwise
+    // a skip of their lines (the last line read may not be finished yet)
+    if(stride > 1 && n_read > 0)
+    {
+        if(indexed)
+        {
+            in_s.seek(known.s[n_read]);
+            if(read_hl)
+                in_hl.seek(known.hl[n_read]);
+        }
+        else
+        {
+            if(!in_s.skip_lines(proj.action ? stride : stride-1))
+                return false;
+            if(read_hl && !in_hl.skip_lines((mid_line ? 1 : 0) + (long long)(stride-1)*n_mat))
+                return false;
+        }
+        mid_line = false;
+    }
+
+    if(proj.action)
+    {
+        if(!in_s.read(smp.S2) || !in_s.read(smp.S4))
+            return false;
+    }
+    else if(!in_s.skip_lines(1))
+        return false;
+
+    // Matrices are stored row by row as (re, im) pairs, one matrix per line,
+    // and go straight into the column major storage
+    for(int i=0; i<n_mat && read_hl; ++i)
+    {
+        if(!want[i])
+        {
+            // The line of the matrix parsed last has to be finished first
+            if(!in_hl.skip_lines(mid_line ? 2 : 1))
+                return false;
+            mid_line = false;
+            continue;
+        }
+
+        cx_double* m = smp.mat[i].memptr();
+        for(int k=0; k<smp.dim; ++k)
+        {
+            for(int l=0; l<smp.dim; ++l)
+            {
+                double re, im;
+                if(!in_hl.read(re) || !in_hl.read(im))
+                    return false;
+                m[k + l*smp.dim] = cx_double(re, im);
+            }
+        }
+        mid_line = true;
+    }
+
+    ++n_read;
+    return true;
+}
+
+bool SampleReader::build_index(SampleIndex& idx)
+{
+    if(bin || zip)
+    {
+        idx.s.resize(n_samples);
+        for(int j=0; j<n_samples; ++j)
+            idx.s[j] = j;
+        idx.hl.clear();
+        return true;
+    }
+
+    if(indexed)
+    {
+        idx = known;
+        return true;
+    }
+
+    idx.s.resize(n_samples);
+    idx.hl.resize(read_hl ? n_samples : 0);
+
+    long long start_s = in_s.tell();
+    long long start_hl = read_hl ? in_hl.tell() : 0;
+
+    for(int j=0; j<n_samples; ++j)
+    {
+        // Samples left out by the view are skipped too, except after the last
+        int skip = j < n_samples-1 ? stride : 1;
+        idx.s[j] = in_s.tell();
+        if(!in_s.skip_lines(skip))
+            return false;
+        if(read_hl)
+        {
+            idx.hl[j] = in_hl.tell();
+            if(!in_hl.skip_lines((long long)skip*n_mat))
+                return false;
+        }
+    }
+
+    in_s.seek(start_s);
+    if(read_hl)
+        in_hl.seek(start_hl);
+    mid_line = false;
+    return true;
+}
+
+bool SampleReader::seek(const SampleIndex& idx, int j)
+{
+    if(j < 0 || j >= n_samples || (int)idx.s.size() != n_samples)
+        return false;
+
+    if(bin || zip)
+    {
+        n_read = j;
+        return bin ? bin->seek(first + (long long)j*stride) : zip->seek(first + (long long)j*stride);
+    }
+
+    in_s.seek(idx.s[j]);
+    if(read_hl)
+        in_hl.seek(idx.hl[j]);
+    mid_line = false;
+    n_read = j;
+    return true;
+}
+
+// Bytes of text each thread parses at a time
+static const long long CHUNK_BYTES = 1 << 20;
+
+ChunkedReader::ChunkedReader(const Dataset& ds_, double g2_, int job_, const Projection& proj_, int n_thr_)
+    : ds(ds_), g2(g2_), job(job_), proj(proj_), n_thr(n_thr_), reader(ds_, g2_, job_, proj_),
+      chunk(1), n_read(0), first(0), n_buf(0), ok(true)
+{
+    reader.set_threads(n_thr);
+    if(n_thr < 2 || !reader.is_open() || reader.binary() || !reader.random_access() || reader.size() < 2)
+    {
+        n_thr = 1;
+        return;
+    }
+
+    // Samples are about the same size, so chunks of a fixed number of them
+    // hold about the same text (the samples between them are not parsed)
+    ok = reader.build_index(idx);
+    int n = reader.size();
+    const vector<streamoff>& off = proj.mats.size() ? idx.hl : idx.s;
+    long long bytes = (off[n-1] - off[0])/((n-1)*(long long)job_view(ds, g2, job).stride);
+    chunk = max(1LL, min((long long)n, CHUNK_BYTES/max(bytes, 1LL)));
+
+    buf.assign(2*n_thr*chunk, proj.mats.size() ? Sample(ds) : Sample());
+    helpers.resize(n_thr);
+}
+
+ChunkedReader::ChunkedReader(const Dataset& ds_, double g2_, int job_, bool read_hl, int n_thr_)
+    : ChunkedReader(ds_, g2_, job_, full_projection(ds_, read_hl), n_thr_)
+{
+}
+
+bool ChunkedReader::fill()
+{
+    // Next chunks are parsed by their own readers, seeking through the index
+    int n = min((int)buf.size(), reader.size()-n_read);
+    int n_chunks = (n + chunk-1)/chunk;
+    vector<char> chunk_ok(n_chunks, 1);
+    parallel_for(0, n_chunks, [&](int c, int t)
+    {
+        if(!helpers[t])
+            helpers[t].reset(new SampleReader(ds, g2, job, idx, proj));
+
+        int begin = c*chunk;
+        int end = min(begin+chunk, n);
+        if(!helpers[t]->seek(idx, n_read+begin))
+        {
+            chunk_ok[c] = 0;
+            return;
+        }
+        for(int j=begin; j<end; ++j)
+            if(!helpers[t]->read(buf[j]))
+                chunk_ok[c] = 0;
+    }, n_thr);
+
+    first = n_read;
+    n_buf = n;
+    return find(chunk_ok.begin(), chunk_ok.end(), 0) == chunk_ok.end();
+}
+
+bool ChunkedReader::read(Sample& smp)
+{
+    if(n_thr < 2)
+        return reader.read(smp);
+
+    if(!ok || n_read == reader.size())
+        return false;
+
+    if(n_read == first + n_buf)
+        if(!(ok = fill()))
+            return false;
+
+    // Swapping hands the sample over without copies, the buffer
+    // gets back matrices of the right size
+    Sample& next = buf[n_read-first];
+    swap(smp.S2, next.S2);
+    swap(smp.S4, next.S4);
+    swap(smp.mat, next.mat);
+    ++n_read;
+    return true;
+}
+
+vector<int> bit_reversed_order(int n)
+{
+    int bits = 0;
+    while((1 << bits) < n)
+        ++bits;
+
+    vector<int> order;
+    order.reserve(n);
+    for(int i=0; i<(1 << bits); ++i)
+    {
+        int r = 0;
+        for(int b=0; b<bits; ++b)
+            if(i & (1 << b))
+                r |= 1 << (bits-1-b);
+        if(r < n)
+            order.push_back(r);
+    }
+    return order;
+}
@@ -0,0 +1,413 @@
+#include <armadillo>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include "dataset.hpp"
+#include "observables.hpp"
+#include "sample.hpp"
+#include "reweight.hpp"
+#include "parallel.hpp"
+#include "scaling.hpp"
+
+using namespace std;
+using namespace arma;
+
+
+bool build_rw_curve(const Dataset& ds, const Observable& obs, int n_pts, double ess_min, RwCurve& curve)
+{
+    curve.dim = ds.sm.dim;
+    curve.n_jobs = ds.job_vec.size();
+    curve.simulated.clear();
+    curve.sums.clear();
+
+    // Simulated g2 values in increasing order
+    vector<double> g2_sim = ds.g2_vec;
+    sort(g2_sim.begin(), g2_sim.end());
+    int n_g2 = g2_sim.size();
+
+    vector<double> grid;
+    for(int a=0; a<n_g2; ++a)
+    {
+        double g2 = g2_sim[a];
+        clog << "g2: " << g2 << endl;
+
+        vector<RwJob> jobs;
+        if(!load_rw_jobs(ds, g2, obs, jobs))
+            return false;
+
+        double n_tot = 0;
+        for(const auto& job : jobs)
+            n_tot += job.S2.n_elem;
+
+        // Each simulated point covers half of the interval to its neighbours,
+        // the shared boundary point is reweighted from the left one
+        double h_left = 0, h_right = 0;
+        if(n_g2 > 1)
+        {
+            h_left = 0.5*(a > 0 ? g2 - g2_sim[a-1] : g2_sim[a+1] - g2);
+            h_right = 0.5*(a < n_g2-1 ? g2_sim[a+1] - g2 : g2 - g2_sim[a-1]);
+        }
+
+        int k_min = (a == 0) ? -n_pts : -n_pts+1;
+        int n_grid = n_pts - k_min + 1;
+        vector<mat> sums(n_grid);
+        vector<double> ess(n_grid);
+        parallel_for(0, n_grid, [&](int n, int)
+        {
+            int k = n + k_min;
+            double g2p = g2 + k*(k < 0 ? h_left : h_right)/n_pts;
+            reweight_sums(jobs, g2, g2p, obs, sums[n]);
+            ess[n] = rw_ess(sum(sums[n], 0))/n_tot;
+        });
+
+        for(int n=0; n<n_grid; ++n)
+        {
+            int k = n + k_min;
+            if(ess[n] < ess_min)
+                continue;
+            grid.push_back(g2 + k*(k < 0 ? h_left : h_right)/n_pts);
+            curve.simulated.push_back(k == 0);
+            curve.sums.push_back(sums[n]);
+        }
+    }
+
+    curve.g2.set_size(grid.size());
+    for(unsigned n=0; n<grid.size(); ++n)
+        curve.g2(n) = grid[n];
+
+    return true;
+}
+
+void curve_values(const RwCurve& curve, double f(const rowvec&), vec& x, vec& y, int skip, bool sim_only)
+{
+    int n_grid = curve.g2.n_elem;
+    int n_out = 0;
+    for(int n=0; n<n_grid; ++n)
+        if(!sim_only || curve.simulated[n])
+            ++n_out;
+
+    x.set_size(n_out);
+    y.set_size(n_out);
+
+    int m = 0;
+    for(int n=0; n<n_grid; ++n)
+    {
+        if(sim_only && !curve.simulated[n])
+            continue;
+
+        // Total over the jobs, minus the one left out
+        rowvec total = sum(curve.sums[n], 0);
+        if(skip >= 0)
+            for(unsigned c=0; c<total.n_elem; ++c)
+                total(c) -= curve.sums[n](skip, c);
+
+        x(m) = curve.g2(n);
+        y(m) = f(total);
+        ++m;
+    }
+}
+
+bool find_peak(const vec& x, const vec& y, double& x_max, double& y_max)
+{
+    int n = x.n_elem;
+    if(n == 0)
+        return false;
+
+    int i = 0;
+    for(int k=1; k<n; ++k)
+        if(y(k) > y(i))
+            i = k;
+
+    x_max = x(i);
+    y_max = y(i);
+
+    // Maximum at the boundary: no refinement possible
+    if(i == 0 || i == n-1)
+        return false;
+
+    // Vertex of the parabola through the three points around the maximum
+    double x0 = x(i-1), x1 = x(i), x2 = x(i+1);
+    double y0 = y(i-1), y1 = y(i), y2 = y(i+1);
+    double d = (x0-x1)*(x0-x2)*(x1-x2);
+    double A = (x2*(y1-y0) + x1*(y0-y2) + x0*(y2-y1))/d;
+    double B = (x2*x2*(y0-y1) + x1*x1*(y2-y0) + x0*x0*(y1-y2))/d;
+    double C = (x1*x2*(x1-x2)*y0 + x2*x0*(x2-x0)*y1 + x0*x1*(x0-x1)*y2)/d;
+
+    if(A >= 0)
+        return true;
+
+    x_max = -B/(2*A);
+    y_max = C - B*B/(4*A);
+    return true;
+}
+
+bool fit_peak(const vec& x, const vec& y, int half_width, double& x_max, double& y_max)
+{
+    int n = x.n_elem;
+    if(n == 0)
+    {
+        x_max = y_max = NAN;
+        return false;
+    }
+
+    // The largest point stands in for the maximum if there is no fit
+    int i = 0;
+    for(int k=1; k<n; ++k)
+        if(y(k) > y(i))
+            i = k;
+    x_max = x(i);
+    y_max = y(i);
+    if(n < 3)
+        return false;
+
+    // Fit window, shifted inside the data if the maximum is close to a boundary
+    int begin = std::max(0, i-half_width);
+    int end = std::min(n-1, begin + 2*half_width);
+    begin = std::max(0, end - 2*half_width);
+
+    vec xw = x.subvec(begin, end);
+    vec yw = y.subvec(begin, end);
+    vec p = polyfit(xw, yw, 2);
+
+    // Not a maximum
+    if(p(0) >= 0)
+        return false;
+
+    x_max = -p(1)/(2*p(0));
+    y_max = p(2) - p(1)*p(1)/(4*p(0));
+    return true;
+}
+
+bool find_crossing(const vec& x1, const vec& y1, const vec& x2, const vec& y2, double x_hint, double& x_c, double& y_c)
+{
+    // Difference of the curves on the points of the first one,
+    // the second curve being linearly interpolated
+    int n1 = x1.n_elem;
+    int n2 = x2.n_elem;
+    if(n1 < 2 || n2 < 2)
+        return false;
+
+    vector<double> xs, ds, ys;
+    int j = 0;
+    for(int i=0; i<n1; ++i)
+    {
+        if(x1(i) < x2(0) || x1(i) > x2(n2-1))
+            continue;
+        while(j < n2-2 && x2(j+1) < x1(i))
+            ++j;
+        double t = (x1(i) - x2(j))/(x2(j+1) - x2(j));
+        double y2i = y2(j) + t*(y2(j+1) - y2(j));
+        xs.push_back(x1(i));
+        ys.push_back(y1(i));
+        ds.push_back(y1(i) - y2i);
+    }
+
+    // Sign change closest to the hint
+    bool found = false;
+    double best = numeric_limits<double>::infinity();
+    for(unsigned k=1; k<xs.size(); ++k)
+    {
+        if(ds[k-1]*ds[k] > 0 || ds[k-1] == ds[k])
+            continue;
+        double t = ds[k-1]/(ds[k-1] - ds[k]);
+        double xc = xs[k-1] + t*(xs[k] - xs[k-1]);
+        if(abs(xc - x_hint) < best)
+        {
+            best = abs(xc - x_hint);
+            x_c = xc;
+            y_c = ys[k-1] + t*(ys[k] - ys[k-1]);
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool load_job_means(const Dataset& ds, const Observable& obs, mat& means)
+{
+    int n_g2 = ds.g2_vec.size();
+    int n_jobs = ds.job_vec.size();
+    means.set_size(n_g2, n_jobs);
+    vector<char> ok(n_g2*n_jobs, 1);
+
+    // Every (g2, job) pair is an independent file
+    parallel_for(0, n_g2*n_jobs, [&](int n, int)
+    {
+        int a = n/n_jobs;
+        int i = n%n_jobs;
+        double g2 = ds.g2_vec[a];
+
+        SampleReader reader(ds, g2, ds.job_vec[i], projection(ds, {&obs}));
+        if(!reader.is_open())
+        {
+            ok[n] = 0;
+            return;
+        }
+
+        Sample smp(ds);
+        vec vec_corr(reader.size());
+        for(int j=0; j<reader.size(); ++j)
+        {
+            if(!reader.read(smp))
+            {
+                ok[n] = 0;
+                return;
+            }
+            vec_corr(j) = obs.f(smp, g2);
+        }
+        means(a, i) = mean(vec_corr);
+    });
+
+    for(int n=0; n<n_g2*n_jobs; ++n)
+    {
+        if(!ok[n])
+        {
+            cerr << "Error: couldn't read job " << ds.job_vec[n%n_jobs] << " at g2 " << ds.g2_vec[n/n_jobs] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void collapse_scale(const CollapseSet& set, const CollapseParams& par, vec& x, vec& y, vec& err)
+{
+    double fy = pow(set.dim, -par.a);
+    double fx = pow(set.dim, par.b);
+
+    int n = set.g2.n_elem;
+    x.set_size(n);
+    y.set_size(n);
+    err.set_size(n);
+    for(int k=0; k<n; ++k)
+    {
+        x(k) = (set.g2(k) - par.g2c)*fx;
+        y(k) = set.y(k)*fy;
+        err(k) = set.err(k)*fy;
+    }
+}
+
+double collapse_quality(const vector<CollapseSet>& sets, const CollapseParams& par)
+{
+    int n_sets = sets.size();
+    vector<vec> x(n_sets), y(n_sets), err(n_sets);
+    for(int s=0; s<n_sets; ++s)
+    {
+        collapse_scale(sets[s], par, x[s], y[s], err[s]);
+
+        // Interpolation below needs increasing x
+        uvec idx(x[s].n_elem);
+        for(unsigned k=0; k<idx.n_elem; ++k)
+            idx(k) = k;
+        sort(idx.begin(), idx.end(), [&](uword i, uword j) { return x[s](i) < x[s](j); });
+        vec xs(idx.n_elem), ys(idx.n_elem), es(idx.n_elem);
+        for(unsigned k=0; k<idx.n_elem; ++k)
+        {
+            xs(k) = x[s](idx(k));
+            ys(k) = y[s](idx(k));
+            es(k) = err[s](idx(k));
+        }
+        x[s] = xs;
+        y[s] = ys;
+        err[s] = es;
+    }
+
+    double quality = 0;
+    int n_pairs = 0;
+    for(int s=0; s<n_sets; ++s)
+    {
+        for(unsigned k=0; k<x[s].n_elem; ++k)
+        {
+            for(int t=0; t<n_sets; ++t)
+            {
+                int n = x[t].n_elem;
+                if(t == s || n < 2 || x[s](k) < x[t](0) || x[s](k) > x[t](n-1))
+                    continue;
+
+                // Bracketing points of set t
+                int j = upper_bound(x[t].begin(), x[t].end(), x[s](k)) - x[t].begin() - 1;
+                if(j >= n-1)
+                    j = n-2;
+                double dx = x[t](j+1) - x[t](j);
+                double u = dx > 0 ? (x[s](k) - x[t](j))/dx : 0;
+                double Y = y[t](j) + u*(y[t](j+1) - y[t](j));
+                double E2 = pow((1-u)*err[t](j), 2) + pow(u*err[t](j+1), 2);
+
+                double den = err[s](k)*err[s](k) + E2;
+                if(den <= 0)
+                    den = 1;
+                quality += pow(y[s](k) - Y, 2)/den;
+                ++n_pairs;
+            }
+        }
+    }
+
+    if(n_pairs == 0)
+        return numeric_limits<double>::infinity();
+    return quality/n_pairs;
+}
+
+double collapse_search(const vector<CollapseSet>& sets, const CollapseParams& lo, const CollapseParams& hi, CollapseParams& best)
+{
+    // Number of grid points per free parameter and number of zoom rounds
+    const int n_grid = 21;
+    const int n_rounds = 6;
+
+    const double l0[3] = {lo.a, lo.b, lo.g2c};
+    const double h0[3] = {hi.a, hi.b, hi.g2c};
+    double l[3] = {lo.a, lo.b, lo.g2c};
+    double h[3] = {hi.a, hi.b, hi.g2c};
+    int n_per[3];
+    int n_tot = 1;
+    for(int p=0; p<3; ++p)
+    {
+        n_per[p] = (h[p] > l[p]) ? n_grid : 1;
+        n_tot *= n_per[p];
+    }
+
+    double best_q = numeric_limits<double>::infinity();
+    double c[3] = {l[0], l[1], l[2]};
+    for(int round=0; round<n_rounds; ++round)
+    {
+        // Evaluate the grid in parallel, then pick the minimum in grid order
+        vec q(n_tot);
+        parallel_for(0, n_tot, [&](int n, int)
+        {
+            int m = n;
+            double v[3];
+            for(int p=0; p<3; ++p)
+            {
+                int k = m%n_per[p];
+                m /= n_per[p];
+                v[p] = (n_per[p] > 1) ? l[p] + k*(h[p]-l[p])/(n_per[p]-1) : l[p];
+            }
+            CollapseParams par = {v[0], v[1], v[2]};
+            q(n) = collapse_quality(sets, par);
+        });
+
+        int n_best = 0;
+        for(int n=1; n<n_tot; ++n)
+            if(q(n) < q(n_best))
+                n_best = n;
+        best_q = q(n_best);
+
+        // Zoom to two grid cells around the minimum, without leaving the box
+        int m = n_best;
+        for(int p=0; p<3; ++p)
+        {
+            int k = m%n_per[p];
+            m /= n_per[p];
+            if(n_per[p] == 1)
+                continue;
+            double step = (h[p]-l[p])/(n_per[p]-1);
+            c[p] = l[p] + k*step;
+            l[p] = std::max(l0[p], c[p] - 2*step);
+            h[p] = std::min(h0[p], c[p] + 2*step);
+        }
+    }
+
+    best.a = c[0];
+    best.b = c[1];
+    best.g2c = c[2];
+    return best_q;
+}
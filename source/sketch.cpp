@@ -0,0 +1,599 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <ostream>
+#include <istream>
+#include "statistics.hpp"
+#include "sketch.hpp"
+
+using namespace std;
+
+
+QuantileSketch::QuantileSketch(int k_)
+    : k(k_), n(0), n_compact(0), levels(1)
+{
+}
+
+int QuantileSketch::capacity(int h) const
+{
+    // Capacities shrink geometrically going down from the top level
+    int depth = levels.size() - 1 - h;
+    int c = ceil(k*pow(2./3., depth));
+    return c < 2 ? 2 : c;
+}
+
+void QuantileSketch::compress()
+{
+    for(unsigned h=0; h<levels.size(); ++h)
+    {
+        if((int)levels[h].size() < capacity(h))
+            continue;
+
+        if(h+1 == levels.size())
+            levels.push_back(vector<double>());
+
+        vector<double>& lev = levels[h];
+        sort(lev.begin(), lev.end());
+
+        // An odd item out stays at this level
+        double leftover = 0;
+        bool odd = lev.size()%2;
+        if(odd)
+        {
+            leftover = lev.back();
+            lev.pop_back();
+        }
+
+        int offset = counter_uniform(k, h, n_compact++) < 0.5 ? 0 : 1;
+        for(unsigned j=offset; j<lev.size(); j+=2)
+            levels[h+1].push_back(lev[j]);
+
+        lev.clear();
+        if(odd)
+            lev.push_back(leftover);
+    }
+}
+
+void QuantileSketch::insert(double x)
+{
+    levels[0].push_back(x);
+    ++n;
+    if((int)levels[0].size() >= capacity(0))
+        compress();
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    if(other.levels.size() > levels.size())
+        levels.resize(other.levels.size());
+
+    for(unsigned h=0; h<other.levels.size(); ++h)
+        levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+
+    n += other.n;
+    compress();
+}
+
+double QuantileSketch::quantile(double q) const
+{
+    // Weighted items in increasing order
+    vector<pair<double, double>> items;
+    double total = 0;
+    for(unsigned h=0; h<levels.size(); ++h)
+    {
+        double w = ldexp(1., h);
+        for(const auto& x : levels[h])
+        {
+            items.push_back(make_pair(x, w));
+            total += w;
+        }
+    }
+
+    if(items.empty())
+        return NAN;
+
+    sort(items.begin(), items.end());
+
+    double target = q*total;
+    double cum = 0;
+    for(const auto& item : items)
+    {
+        cum += item.second;
+        if(cum >= target)
+            return item.first;
+    }
+    return items.back().first;
+}
+
+void QuantileSketch::write(ostream& out) const
+{
+    streamsize prec = out.precision(17);
+    out << k << " " << n << " " << n_compact << " " << levels.size() << endl;
+    for(const auto& lev : levels)
+    {
+        out << lev.size();
+        for(const auto& x : lev)
+            out << " " << x;
+        out << endl;
+    }
+    out.precision(prec);
+}
+
+bool QuantileSketch::read(istream& in)
+{
+    unsigned n_levels;
+    if(!(in >> k >> n >> n_compact >> n_levels))
+        return false;
+
+    levels.assign(n_levels, vector<double>());
+    for(auto& lev : levels)
+    {
+        unsigned size;
+        if(!(in >> size))
+            return false;
+        lev.resize(size);
+        for(auto& x : lev)
+            in >> x;
+    }
+    return (bool)in;
+}
+
+
+// Index of bin i after doubling the width
+static long long half(long long i)
+{
+    return i >= 0 ? i/2 : -((-i+1)/2);
+}
+
+Histogram::Histogram(int n_bins_)
+    : n_bins(n_bins_ + n_bins_%2), e(0), i_lo(0), i_first(0), i_last(-1), n(0), count(n_bins, 0.)
+{
+}
+
+double Histogram::width() const
+{
+    return ldexp(1., e);
+}
+
+void Histogram::coarsen()
+{
+    // Double the width: bin i goes to floor(i/2)
+    vector<double> coarse(n_bins, 0.);
+    long long lo = half(i_lo);
+    for(int b=0; b<n_bins; ++b)
+        coarse[half(i_lo+b) - lo] += count[b];
+
+    count = coarse;
+    i_lo = lo;
+    i_first = half(i_first);
+    i_last = half(i_last);
+    ++e;
+}
+
+// Add weight to absolute bin i of width 2^e_i, widening the range if needed
+void Histogram::add(long long i, int e_i, double weight)
+{
+    // Bring the incoming bin to the current width
+    while(e_i < e)
+    {
+        i = half(i);
+        ++e_i;
+    }
+
+    while(true)
+    {
+        // Occupied span including the new bin
+        bool empty = i_last < i_first;
+        long long first = empty ? i : std::min(i_first, i);
+        long long last = empty ? i : std::max(i_last, i);
+
+        if(last - first < n_bins)
+        {
+            // Re-center the window on the occupied span if needed
+            if(first < i_lo || last >= i_lo + n_bins)
+            {
+                long long lo = first - (n_bins - (last-first+1))/2;
+                vector<double> moved(n_bins, 0.);
+                for(long long c=i_first; c<=i_last; ++c)
+                    moved[c-lo] = count[c-i_lo];
+                count = moved;
+                i_lo = lo;
+            }
+            count[i - i_lo] += weight;
+            i_first = first;
+            i_last = last;
+            return;
+        }
+
+        coarsen();
+        i = half(i);
+    }
+}
+
+// Bin indices stay well inside long long
+static const double MAX_INDEX = ldexp(1., 62);
+
+bool Histogram::insert(double x, double weight)
+{
+    if(!std::isfinite(x))
+        return false;
+
+    // The first value fixes the finest resolution: 2^-8 of its magnitude
+    if(n == 0)
+    {
+        e = (x == 0) ? -30 : (int)floor(log2(std::abs(x))) - 8;
+        i_lo = (long long)floor(ldexp(x, -e)) - n_bins/2;
+    }
+
+    // A value far from the first ones needs wider bins before its index fits
+    while(std::abs(ldexp(x, -e)) >= MAX_INDEX)
+        coarsen();
+
+    add((long long)floor(ldexp(x, -e)), e, weight);
+    ++n;
+    return true;
+}
+
+void Histogram::merge(const Histogram& other)
+{
+    if(other.n == 0)
+        return;
+
+    if(n == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    // Both go to the coarser width, then bins are added one by one
+    while(e < other.e)
+        coarsen();
+    for(long long c=other.i_first; c<=other.i_last; ++c)
+    {
+        double w = other.count[c-other.i_lo];
+        if(w != 0)
+            add(c, other.e, w);
+    }
+    n += other.n;
+}
+
+// Range of occupied bins and total weight
+static void occupied(const vector<double>& count, int& first, int& last, double& total)
+{
+    first = count.size();
+    last = -1;
+    total = 0;
+    for(int b=0; b<(int)count.size(); ++b)
+    {
+        if(count[b] != 0)
+        {
+            first = std::min(first, b);
+            last = b;
+            total += count[b];
+        }
+    }
+}
+
+// Nonzero entries of a vector of counts as "size nonzero (index count)..."
+static void write_counts(ostream& out, const vector<double>& count)
+{
+    int nonzero = 0;
+    for(const auto& c : count)
+        nonzero += (c != 0);
+
+    out << count.size() << " " << nonzero;
+    for(unsigned b=0; b<count.size(); ++b)
+        if(count[b] != 0)
+            out << " " << b << " " << count[b];
+    out << endl;
+}
+
+static bool read_counts(istream& in, vector<double>& count)
+{
+    unsigned size;
+    int nonzero;
+    if(!(in >> size >> nonzero))
+        return false;
+
+    count.assign(size, 0.);
+    for(int j=0; j<nonzero; ++j)
+    {
+        unsigned b;
+        double c;
+        if(!(in >> b >> c) || b >= size)
+            return false;
+        count[b] = c;
+    }
+    return true;
+}
+
+void Histogram::print(ostream& out) const
+{
+    int first, last;
+    double total;
+    occupied(count, first, last, total);
+
+    double w = width();
+    for(int b=first; b<=last; ++b)
+        out << (i_lo+b+0.5)*w << " " << count[b]/(total*w) << endl;
+}
+
+void Histogram::print(ostream& out, double prefix) const
+{
+    int first, last;
+    double total;
+    occupied(count, first, last, total);
+
+    double w = width();
+    for(int b=first; b<=last; ++b)
+        out << prefix << " " << (i_lo+b+0.5)*w << " " << count[b]/(total*w) << endl;
+}
+
+void Histogram::write(ostream& out) const
+{
+    streamsize prec = out.precision(17);
+    out << n_bins << " " << e << " " << i_lo << " " << n << endl;
+    write_counts(out, count);
+    out.precision(prec);
+}
+
+bool Histogram::read(istream& in)
+{
+    if(!(in >> n_bins >> e >> i_lo >> n))
+        return false;
+    if(!read_counts(in, count) || (int)count.size() != n_bins)
+        return false;
+
+    // The occupied span isn't stored, the format predates it
+    int first, last;
+    double total;
+    occupied(count, first, last, total);
+    i_first = i_lo + first;
+    i_last = i_lo + last;
+    return true;
+}
+
+
+Histogram2D::Histogram2D(int n_bins_)
+    : n_bins(n_bins_ + n_bins_%2), ex(0), ey(0), ix_lo(0), iy_lo(0),
+      ix_first(0), ix_last(-1), iy_first(0), iy_last(-1), n(0), count(n_bins*n_bins, 0.)
+{
+}
+
+double Histogram2D::width_x() const
+{
+    return ldexp(1., ex);
+}
+
+double Histogram2D::width_y() const
+{
+    return ldexp(1., ey);
+}
+
+// Double the width along x (axis 0) or y (axis 1)
+void Histogram2D::coarsen(int axis)
+{
+    vector<double> coarse(n_bins*n_bins, 0.);
+    long long x_lo = axis == 0 ? half(ix_lo) : ix_lo;
+    long long y_lo = axis == 1 ? half(iy_lo) : iy_lo;
+    for(int bx=0; bx<n_bins; ++bx)
+    {
+        for(int by=0; by<n_bins; ++by)
+        {
+            long long cx = axis == 0 ? half(ix_lo+bx) : ix_lo+bx;
+            long long cy = axis == 1 ? half(iy_lo+by) : iy_lo+by;
+            coarse[(cx-x_lo)*n_bins + cy-y_lo] += count[bx*n_bins + by];
+        }
+    }
+
+    count = coarse;
+    ix_lo = x_lo;
+    iy_lo = y_lo;
+    if(axis == 0)
+    {
+        ix_first = half(ix_first);
+        ix_last = half(ix_last);
+        ++ex;
+    }
+    else
+    {
+        iy_first = half(iy_first);
+        iy_last = half(iy_last);
+        ++ey;
+    }
+}
+
+// Add weight to absolute bin (ix, iy) of widths (2^ex_i, 2^ey_i), widening the range if needed
+void Histogram2D::add(long long ix, long long iy, int ex_i, int ey_i, double weight)
+{
+    // Bring the incoming bin to the current widths
+    for(; ex_i < ex; ++ex_i)
+        ix = half(ix);
+    for(; ey_i < ey; ++ey_i)
+        iy = half(iy);
+
+    while(true)
+    {
+        // Occupied rectangle including the new bin
+        bool empty = ix_last < ix_first;
+        long long fx = empty ? ix : std::min(ix_first, ix);
+        long long lx = empty ? ix : std::max(ix_last, ix);
+        long long fy = empty ? iy : std::min(iy_first, iy);
+        long long ly = empty ? iy : std::max(iy_last, iy);
+
+        bool fit_x = lx - fx < n_bins;
+        bool fit_y = ly - fy < n_bins;
+        if(fit_x && fit_y)
+        {
+            // Re-center the window on the occupied rectangle if needed
+            bool out_x = fx < ix_lo || lx >= ix_lo + n_bins;
+            bool out_y = fy < iy_lo || ly >= iy_lo + n_bins;
+            if(out_x || out_y)
+            {
+                long long x_lo = out_x ? fx - (n_bins - (lx-fx+1))/2 : ix_lo;
+                long long y_lo = out_y ? fy - (n_bins - (ly-fy+1))/2 : iy_lo;
+                vector<double> moved(n_bins*n_bins, 0.);
+                for(long long cx=ix_first; cx<=ix_last; ++cx)
+                    for(long long cy=iy_first; cy<=iy_last; ++cy)
+                        moved[(cx-x_lo)*n_bins + cy-y_lo] = count[(cx-ix_lo)*n_bins + cy-iy_lo];
+                count = moved;
+                ix_lo = x_lo;
+                iy_lo = y_lo;
+            }
+
+            count[(ix-ix_lo)*n_bins + iy-iy_lo] += weight;
+            ix_first = fx;
+            ix_last = lx;
+            iy_first = fy;
+            iy_last = ly;
+            return;
+        }
+
+        if(!fit_x)
+        {
+            coarsen(0);
+            ix = half(ix);
+        }
+        if(!fit_y)
+        {
+            coarsen(1);
+            iy = half(iy);
+        }
+    }
+}
+
+bool Histogram2D::insert(double x, double y, double weight)
+{
+    if(!std::isfinite(x) || !std::isfinite(y))
+        return false;
+
+    // The first point fixes the finest resolution: 2^-8 of its magnitude
+    if(n == 0)
+    {
+        ex = (x == 0) ? -30 : (int)floor(log2(std::abs(x))) - 8;
+        ey = (y == 0) ? -30 : (int)floor(log2(std::abs(y))) - 8;
+        ix_lo = (long long)floor(ldexp(x, -ex)) - n_bins/2;
+        iy_lo = (long long)floor(ldexp(y, -ey)) - n_bins/2;
+    }
+
+    // A point far from the first ones needs wider bins before its indices fit
+    while(std::abs(ldexp(x, -ex)) >= MAX_INDEX)
+        coarsen(0);
+    while(std::abs(ldexp(y, -ey)) >= MAX_INDEX)
+        coarsen(1);
+
+    add((long long)floor(ldexp(x, -ex)), (long long)floor(ldexp(y, -ey)), ex, ey, weight);
+    ++n;
+    return true;
+}
+
+void Histogram2D::merge(const Histogram2D& other)
+{
+    if(other.n == 0)
+        return;
+
+    if(n == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    // Both go to the coarser widths, then bins are added one by one
+    while(ex < other.ex)
+        coarsen(0);
+    while(ey < other.ey)
+        coarsen(1);
+    for(long long cx=other.ix_first; cx<=other.ix_last; ++cx)
+    {
+        for(long long cy=other.iy_first; cy<=other.iy_last; ++cy)
+        {
+            double c = other.count[(cx-other.ix_lo)*other.n_bins + cy-other.iy_lo];
+            if(c != 0)
+                add(cx, cy, other.ex, other.ey, c);
+        }
+    }
+    n += other.n;
+}
+
+vector<double> Histogram2D::counts_on(const Histogram2D& grid) const
+{
+    vector<double> res(grid.n_bins*grid.n_bins, 0.);
+    if(n == 0)
+        return res;
+
+    Histogram2D tmp(*this);
+    while(tmp.ex < grid.ex)
+        tmp.coarsen(0);
+    while(tmp.ey < grid.ey)
+        tmp.coarsen(1);
+
+    for(long long cx=tmp.ix_first; cx<=tmp.ix_last; ++cx)
+    {
+        for(long long cy=tmp.iy_first; cy<=tmp.iy_last; ++cy)
+        {
+            long long bx = cx - grid.ix_lo;
+            long long by = cy - grid.iy_lo;
+            if(bx < 0 || bx >= grid.n_bins || by < 0 || by >= grid.n_bins)
+                continue;
+            res[bx*grid.n_bins + by] += tmp.count[(cx-tmp.ix_lo)*n_bins + cy-tmp.iy_lo];
+        }
+    }
+    return res;
+}
+
+void Histogram2D::print(ostream& out, double prefix, const vector<Histogram2D>& parts) const
+{
+    if(n == 0)
+        return;
+
+    double area = width_x()*width_y();
+    double total = 0;
+    for(const auto& c : count)
+        total += c;
+
+    // Counts and total weight of each part on this grid
+    int n_parts = parts.size();
+    vector<vector<double>> part_count(n_parts);
+    arma::vec part_total(n_parts, arma::fill::zeros);
+    for(int j=0; j<n_parts; ++j)
+    {
+        part_count[j] = parts[j].counts_on(*this);
+        for(const auto& c : part_count[j])
+            part_total(j) += c;
+    }
+
+    for(long long cx=ix_first; cx<=ix_last; ++cx)
+    {
+        for(long long cy=iy_first; cy<=iy_last; ++cy)
+        {
+            int b = (cx-ix_lo)*n_bins + cy-iy_lo;
+            double avg = count[b]/(total*area);
+            double var = 0;
+            if(n_parts > 1)
+            {
+                arma::vec del1(n_parts);
+                for(int j=0; j<n_parts; ++j)
+                    del1(j) = (count[b] - part_count[j][b])/((total - part_total(j))*area);
+                jackknife_del1(del1, avg, var);
+            }
+            out << prefix << " " << (cx+0.5)*width_x() << " " << (cy+0.5)*width_y() << " " << avg << " " << sqrt(var) << endl;
+        }
+        out << endl;
+    }
+}
+
+void Histogram2D::write(ostream& out) const
+{
+    streamsize prec = out.precision(17);
+    out << n_bins << " " << ex << " " << ey << " " << ix_lo << " " << iy_lo << " ";
+    out << ix_first << " " << ix_last << " " << iy_first << " " << iy_last << " " << n << endl;
+    write_counts(out, count);
+    out.precision(prec);
+}
+
+bool Histogram2D::read(istream& in)
+{
+    if(!(in >> n_bins >> ex >> ey >> ix_lo >> iy_lo >> ix_first >> ix_last >> iy_first >> iy_last >> n))
+        return false;
+    return read_counts(in, count) && (int)count.size() == n_bins*n_bins;
+}
@@ -1,6 +1,11 @@
 #include <armadillo>
+#include <iostream>
 #include <cmath>
+#include <vector>
+#include <cstdint>
+#include <limits>
 #include "statistics.hpp"
+#include "parallel.hpp"
 
 using namespace std;
 using namespace arma;
@@ -34,6 +39,13 @@ void jackknife(const vec& vec_uncorr, double& avg, double& var, double f(const v
         vec_del1(i) = f(ith_cluster);
     }
 
+    jackknife_del1(vec_del1, avg, var);
+}
+
+void jackknife_del1(const vec& vec_del1, double& avg, double& var)
+{
+    int size = vec_del1.n_elem;
+
     // Calculate mean
     avg = mean(vec_del1);
 
@@ -44,6 +56,236 @@ void jackknife(const vec& vec_uncorr, double& avg, double& var, double f(const v
     var *= (double)(size-1)/size;
 }
 
+void jackknife_sums(const mat& sums, double& avg, double& var, double f(const rowvec&))
+{
+    int size = sums.n_rows;
+    int n_comp = sums.n_cols;
+
+    // Sum of every component over all jobs
+    rowvec total(n_comp, fill::zeros);
+    for(int i=0; i<size; ++i)
+        for(int k=0; k<n_comp; ++k)
+            total(k) += sums(i,k);
+
+    // Create vector of delete-1 clusters
+    vec vec_del1(size);
+    
+    // Calculate delete-1 clusters
+    rowvec ith_cluster(n_comp);
+    for(int i=0; i<size; ++i)
+    {
+        for(int k=0; k<n_comp; ++k)
+            ith_cluster(k) = total(k) - sums(i,k);
+        vec_del1(i) = f(ith_cluster);
+    }
+
+    jackknife_del1(vec_del1, avg, var);
+}
+
+int mser_cut(const vec& series, int batch)
+{
+    int n_batch = series.n_elem/batch;
+    if(n_batch < 2)
+        return 0;
+
+    // Batch means
+    vec z(n_batch, fill::zeros);
+    for(int k=0; k<n_batch; ++k)
+    {
+        for(int j=0; j<batch; ++j)
+            z(k) += series(k*batch + j);
+        z(k) /= batch;
+    }
+
+    // Suffix sums give the MSER statistic of every cut in one pass
+    vec sum1(n_batch+1, fill::zeros), sum2(n_batch+1, fill::zeros);
+    for(int k=n_batch-1; k>=0; --k)
+    {
+        sum1(k) = sum1(k+1) + z(k);
+        sum2(k) = sum2(k+1) + z(k)*z(k);
+    }
+
+    int d_best = 0;
+    double mser_best = numeric_limits<double>::infinity();
+    for(int d=0; d<=n_batch/2; ++d)
+    {
+        double m = n_batch - d;
+        double mser = (sum2(d) - sum1(d)*sum1(d)/m)/(m*m);
+        if(mser < mser_best)
+        {
+            mser_best = mser;
+            d_best = d;
+        }
+    }
+
+    return d_best*batch;
+}
+
+// Squared standard error of the mean of a correlated series from 10 batch means
+static double batch_err2(const vec& x)
+{
+    const int n_batch = 10;
+    int batch = x.n_elem/n_batch;
+    if(batch < 1)
+        return var(x)/x.n_elem;
+
+    vec z(n_batch, fill::zeros);
+    for(int k=0; k<n_batch; ++k)
+    {
+        for(int j=0; j<batch; ++j)
+            z(k) += x(k*batch + j);
+        z(k) /= batch;
+    }
+    return var(z)/n_batch;
+}
+
+double batch_err(const vec& x)
+{
+    if(x.n_elem < 2)
+        return 0;
+    return sqrt(batch_err2(x));
+}
+
+double geweke_z(const vec& series, double first, double last)
+{
+    int n = series.n_elem;
+    int n_a = first*n;
+    int n_b = last*n;
+    if(n_a < 2 || n_b < 2)
+        return 0;
+
+    vec a = series.subvec(0, n_a-1);
+    vec b = series.subvec(n-n_b, n-1);
+    double den = sqrt(batch_err2(a) + batch_err2(b));
+    if(den == 0)
+        return 0;
+    return (mean(a) - mean(b))/den;
+}
+
+// SplitMix64 finalizer, used as the mixing function of the counter-based generator
+static uint64_t mix64(uint64_t z)
+{
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double counter_uniform(unsigned long seed, unsigned long stream, unsigned long counter)
+{
+    uint64_t x = mix64(mix64(mix64(seed) ^ stream) ^ counter);
+    
+    // Keep the 53 most significant bits
+    return (x >> 11) * (1./9007199254740992.);
+}
+
+// Fill reps with n_rep bootstrap replicas of f, resampling blocks of length block
+static void bootstrap_replicas(const vec& data, int block, double f(const vec&), int n_rep, unsigned long seed, vec& reps)
+{
+    int size = data.n_elem;
+    if(block < 1)
+        block = 1;
+    if(block > size)
+        block = size;
+
+    // Number of admissible block starting points
+    int n_start = size - block + 1;
+    
+    // One resampling buffer per thread, reused by every replica
+    int n_thr = n_threads();
+    vector<vec> buffers(n_thr, vec(size));
+
+    reps.set_size(n_rep);
+    parallel_for(0, n_rep, [&](int r, int t)
+    {
+        vec& resampled = buffers[t];
+
+        // Glue together randomly chosen blocks, the last one is truncated
+        int filled = 0;
+        unsigned long draw = 0;
+        while(filled < size)
+        {
+            int start = counter_uniform(seed, r, draw++)*n_start;
+            for(int k=0; k<block && filled<size; ++k)
+                resampled(filled++) = data(start+k);
+        }
+
+        reps(r) = f(resampled);
+    }, n_thr);
+}
+
+// Mean, variance and percentile interval of a set of replicas
+static void replica_summary(const vec& reps, double& avg, double& var, double& lo, double& hi, double cl)
+{
+    int n_rep = reps.n_elem;
+
+    // Calculate mean
+    avg = mean(reps);
+
+    // Calculate variance
+    var = 0;
+    for(int i=0; i<n_rep; ++i)
+        var += pow(reps(i) - avg, 2);
+    var /= n_rep-1;
+
+    // Interpolated percentiles of the sorted replicas
+    vec sorted = sort(reps);
+    auto percentile = [&](double x)
+    {
+        double pos = x*(n_rep-1);
+        int i = floor(pos);
+        if(i >= n_rep-1)
+            return sorted(n_rep-1);
+        return sorted(i) + (pos-i)*(sorted(i+1)-sorted(i));
+    };
+    lo = percentile(0.5*(1.-cl));
+    hi = percentile(0.5*(1.+cl));
+}
+
+// The variance needs at least 2 replicas
+static bool check_replicas(const vec& data, int n_rep)
+{
+    if(n_rep < 2)
+    {
+        cerr << "Error: the bootstrap needs at least 2 replicas, not " << n_rep << endl;
+        return false;
+    }
+    if(data.is_empty())
+    {
+        cerr << "Error: no data to bootstrap" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool bootstrap(const vec& vec_uncorr, double& avg, double& var, double f(const vec&), int n_rep, unsigned long seed)
+{
+    double lo, hi;
+    return bootstrap(vec_uncorr, avg, var, lo, hi, f, 0.6827, n_rep, seed);
+}
+
+bool bootstrap(const vec& vec_uncorr, double& avg, double& var, double& lo, double& hi, double f(const vec&), double cl, int n_rep, unsigned long seed)
+{
+    if(!check_replicas(vec_uncorr, n_rep))
+        return false;
+
+    vec reps;
+    bootstrap_replicas(vec_uncorr, 1, f, n_rep, seed, reps);
+    replica_summary(reps, avg, var, lo, hi, cl);
+    return true;
+}
+
+bool block_bootstrap(const vec& vec_corr, int block, double& avg, double& var, double& lo, double& hi, double f(const vec&), double cl, int n_rep, unsigned long seed)
+{
+    if(!check_replicas(vec_corr, n_rep))
+        return false;
+
+    vec reps;
+    bootstrap_replicas(vec_corr, block, f, n_rep, seed, reps);
+    replica_summary(reps, avg, var, lo, hi, cl);
+    return true;
+}
+
 double my_mean(const vec& vec_uncorr)
 {
     return mean(vec_uncorr);
@@ -0,0 +1,223 @@
+#include <armadillo>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <sys/stat.h>
+#include "utils.hpp"
+#include "dataset.hpp"
+#include "observables.hpp"
+#include "cache.hpp"
+#include "store.hpp"
+
+using namespace std;
+using namespace arma;
+
+// Bump when the layout below changes
+static const int32_t STORE_FORMAT = 3;
+
+// Fixed-size header in front of the values (native byte order); the values
+// are followed by the block pyramid
+struct ColumnHeader
+{
+    char magic[4];
+    int32_t format;
+    int32_t version;
+    int32_t first;
+    int32_t stride;
+    int32_t size;
+    int64_t s_size;
+    int64_t s_mtime;
+    int64_t hl_size;
+    int64_t hl_mtime;
+    int64_t n;
+};
+
+void BlockPyramid::append(double x)
+{
+    sum1 += x;
+    sum2 += x*x;
+    if(n++ % 2 == 0)
+    {
+        pending = x;
+        return;
+    }
+
+    // A completed pair goes up as far as it completes blocks
+    double sum = pending + x;
+    for(unsigned k=0; ; ++k)
+    {
+        if(k == levels.size())
+            levels.push_back(vector<double>());
+        levels[k].push_back(sum);
+        if(levels[k].size() % 2)
+            break;
+        sum = levels[k][levels[k].size()-2] + levels[k].back();
+    }
+}
+
+vec BlockPyramid::block_means(int k) const
+{
+    if(k < 1 || k > depth())
+        return vec();
+
+    const vector<double>& lev = levels[k-1];
+    double size = ldexp(1., k);
+    vec means(lev.size());
+    for(unsigned b=0; b<lev.size(); ++b)
+        means(b) = lev[b]/size;
+    return means;
+}
+
+void BlockPyramid::write(ostream& out) const
+{
+    int64_t n_levels = levels.size();
+    out.write((const char*)&n, sizeof(n));
+    out.write((const char*)&pending, sizeof(pending));
+    out.write((const char*)&sum1, sizeof(sum1));
+    out.write((const char*)&sum2, sizeof(sum2));
+    out.write((const char*)&n_levels, sizeof(n_levels));
+    for(const auto& lev : levels)
+    {
+        int64_t size = lev.size();
+        out.write((const char*)&size, sizeof(size));
+        out.write((const char*)lev.data(), size*sizeof(double));
+    }
+}
+
+bool BlockPyramid::read(istream& in)
+{
+    int64_t n_levels;
+    if(!in.read((char*)&n, sizeof(n)) || !in.read((char*)&pending, sizeof(pending)) || !in.read((char*)&sum1, sizeof(sum1)) || !in.read((char*)&sum2, sizeof(sum2)) || !in.read((char*)&n_levels, sizeof(n_levels)))
+        return false;
+
+    // Level k holds n/2^(k+1) sums
+    if(n < 0 || n_levels < 0 || n_levels > 62)
+        return false;
+    levels.assign(n_levels, vector<double>());
+    for(int k=0; k<n_levels; ++k)
+    {
+        int64_t size;
+        if(!in.read((char*)&size, sizeof(size)) || size != (n >> (k+1)))
+            return false;
+        levels[k].resize(size);
+        if(!in.read((char*)levels[k].data(), size*sizeof(double)))
+            return false;
+    }
+    return true;
+}
+
+// Header a column of this observable should have now
+static ColumnHeader current_header(const Dataset& ds, double g2, int job, const Observable& obs)
+{
+    ColumnHeader h;
+    memcpy(h.magic, "RFLC", 4);
+    h.format = STORE_FORMAT;
+    h.version = obs.version;
+    JobView view = job_view(ds, g2, job);
+    h.first = view.first;
+    h.stride = view.stride;
+    h.size = view.size;
+
+    string filename = data_path(ds, g2, job);
+    FileStamp s, hl;
+    file_stamp(filename + "_S.txt", s);
+    if(obs.need_hl)
+        file_stamp(filename + "_HL.txt", hl);
+    h.s_size = s.size;
+    h.s_mtime = s.mtime;
+    h.hl_size = hl.size;
+    h.hl_mtime = hl.mtime;
+    h.n = 0;
+    return h;
+}
+
+static bool same_source(const ColumnHeader& a, const ColumnHeader& b)
+{
+    return !memcmp(a.magic, b.magic, 4) && a.format == b.format && a.version == b.version
+        && a.first == b.first && a.stride == b.stride && a.size == b.size
+        && a.s_size == b.s_size && a.s_mtime == b.s_mtime && a.hl_size == b.hl_size && a.hl_mtime == b.hl_mtime;
+}
+
+string column_filename(const Dataset& ds, double g2, int job, const string& name)
+{
+    return ds.path + "/store/" + cc_to_name(g2) + "_" + to_string(job) + "_" + name + ".bin";
+}
+
+bool make_store_dir(const Dataset& ds)
+{
+    string dir = ds.path + "/store";
+    if(mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        cerr << "Error: directory " + dir + " could not be created." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool write_column(const Dataset& ds, double g2, int job, const Observable& obs, const vec& values)
+{
+    ColumnHeader h = current_header(ds, g2, job, obs);
+    if(h.s_size < 0)
+        return false;
+    h.n = values.n_elem;
+
+    ofstream out;
+    out.open(column_filename(ds, g2, job, obs.name), ios::binary);
+    if(!out)
+        return false;
+
+    BlockPyramid pyr;
+    for(const auto& x : values)
+        pyr.append(x);
+
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)values.memptr(), values.n_elem*sizeof(double));
+    pyr.write(out);
+    return (bool)out;
+}
+
+// Open a column and check its header, leaving the stream at the values
+static bool open_column(const Dataset& ds, double g2, int job, const Observable& obs, ifstream& in, ColumnHeader& h)
+{
+    in.open(column_filename(ds, g2, job, obs.name), ios::binary);
+    if(!in)
+        return false;
+
+    if(!in.read((char*)&h, sizeof(h)))
+        return false;
+    return same_source(h, current_header(ds, g2, job, obs)) && h.n >= 0;
+}
+
+bool read_column(const Dataset& ds, double g2, int job, const Observable& obs, vec& values)
+{
+    ifstream in;
+    ColumnHeader h;
+    if(!open_column(ds, g2, job, obs, in, h))
+        return false;
+
+    values.set_size(h.n);
+    return (bool)in.read((char*)values.memptr(), h.n*sizeof(double));
+}
+
+bool column_valid(const Dataset& ds, double g2, int job, const Observable& obs)
+{
+    ifstream in;
+    ColumnHeader h;
+    return open_column(ds, g2, job, obs, in, h);
+}
+
+bool read_pyramid(const Dataset& ds, double g2, int job, const Observable& obs, BlockPyramid& pyr)
+{
+    ifstream in;
+    ColumnHeader h;
+    if(!open_column(ds, g2, job, obs, in, h))
+        return false;
+
+    // Skip the values
+    in.seekg(h.n*sizeof(double), ios::cur);
+    return pyr.read(in) && pyr.size() == h.n;
+}